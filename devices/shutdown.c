@@ -5,6 +5,12 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/memtrack.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -13,6 +19,11 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -120,6 +131,15 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  kmem_print_stats ();
+#ifdef MEM_TRACK
+  memtrack_print_stats ();
+#endif
+#ifdef LOCK_PROFILE
+  lock_print_stats ();
+#endif
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -128,4 +148,10 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  page_print_stats ();
+  frame_print_stats ();
+  swap_print_stats ();
+#endif
+  profile_print_stats ();
 }
@@ -1,10 +1,12 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -20,13 +22,91 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
+/* List of threads blocked in timer_sleep(), ordered by
+   `wakeup_tick', earliest first.  Accessed by the timer
+   interrupt handler, so it is protected by disabling
+   interrupts. */
+static struct list sleep_list;
+
+/* Kernel timers, kept in a hierarchical timing wheel.
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each slot of level L > 0 covers WHEEL_SIZE times as many ticks
+   as a slot of level L - 1.  A timer is placed in the lowest
+   level that reaches its deadline, in the slot selected by the
+   corresponding bits of the deadline.  When the wheel's level 0
+   wraps around, the next slot of level 1 is "cascaded" by
+   re-adding its timers, which now land in level 0, and so on up
+   the levels.
+
+   Thus, adding and canceling a timer are O(1), and each timer
+   is cascaded at most WHEEL_LEVELS - 1 times before it runs,
+   which makes the work per tick amortized O(1).  Timers further
+   out than the wheel reaches wait in its last slot and are
+   re-added when it is cascaded.
+
+   The wheel is accessed by the timer interrupt handler, so it is
+   protected by disabling interrupts. */
+#define WHEEL_BITS 6                    /* Bits of deadline per level. */
+#define WHEEL_SIZE (1 << WHEEL_BITS)    /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4                  /* Number of levels. */
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_tick;      /* Next tick for the wheel to process. */
+static int wheel_cnt;           /* Number of pending timers. */
+
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000 * 1000 * 1000 / TIMER_FREQ)
+
+/* Number of timer ticks that timer_calibrate() measures the TSC
+   over.  More ticks average out the interrupt latency at either
+   end of the measurement. */
+#define CALIBRATE_TICKS 10
+
+/* Number of TSC cycles per timer tick.
    Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+static uint32_t tsc_per_tick;
+
+/* TSC value sampled by the timer interrupt at the most recent
+   tick, and the latest value returned by timer_now_ns(). */
+static uint64_t tick_tsc;
+static int64_t last_now_ns;
+
+/* Tickless idle.
+
+   If timer_tickless is true, then whenever the CPU goes idle,
+   timer_idle_enter() switches PIT channel 0 from periodic mode
+   to a one-shot countdown that ends at the next sleeper's
+   wake-up tick (or as far out as the 16-bit counter allows), so
+   that an idle CPU is not woken up at every tick.  When the CPU
+   stops idling, timer_idle_exit() catches `ticks' up on the
+   whole ticks that went by and returns the PIT to periodic
+   mode.
+
+   A one-shot countdown is started in step with the tick grid,
+   so waking up because it expired loses no time.  Waking up
+   early because of another interrupt leaves the CPU partway
+   through a tick, so timer_idle_exit() first starts a second,
+   short one-shot for the rest of that tick, and periodic mode
+   resumes when it expires, back on the grid. */
+bool timer_tickless;
+
+/* PIT counts per timer tick, as programmed by timer_init(). */
+#define TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+static bool oneshot_armed;      /* Channel 0 in one-shot mode? */
+static int oneshot_ticks;       /* Ticks until the one-shot expires. */
+static unsigned oneshot_start;  /* PIT counts into tick when armed. */
+static unsigned oneshot_count;  /* PIT counts programmed. */
+static bool resync_armed;       /* One-shot to end of tick running? */
+static int64_t saved_interrupts; /* Total ticks without an interrupt. */
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
+static void wheel_insert (struct timer *);
+static void wheel_advance (void);
+static int64_t wheel_next_tick (int64_t limit);
+static list_less_func wakeup_less;
+static void tsc_wait (uint64_t cycles);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
@@ -35,35 +115,43 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  int level, slot;
+
   pit_configure_channel (0, 2, TIMER_FREQ);
+  list_init (&sleep_list);
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_tick = 1;
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates tsc_per_tick, used to implement brief delays and
+   timer_now_ns(), by counting TSC cycles across
+   CALIBRATE_TICKS timer ticks. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
+  uint64_t start_tsc;
+  int64_t start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
-    {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
-    }
+  /* Wait for a timer tick, so that we start on a tick edge. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  /* Count cycles across CALIBRATE_TICKS ticks. */
+  start_tsc = timer_read_tsc ();
+  start = ticks;
+  while (ticks - start < CALIBRATE_TICKS)
+    barrier ();
+  tsc_per_tick = (timer_read_tsc () - start_tsc) / CALIBRATE_TICKS;
+  ASSERT (tsc_per_tick != 0);
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" cycles/s.\n", (uint64_t) tsc_per_tick * TIMER_FREQ);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,16 +172,114 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted.
+
+   The result is the start of the current timer tick plus the
+   TSC cycles elapsed since then, so it has the TSC's resolution
+   but never drifts from timer_ticks().  Because the calibration
+   is not exact, the sub-tick part may overshoot the next tick
+   slightly; such readings are held back to keep the result
+   monotonic.  Until timer_calibrate() runs, the resolution is
+   one timer tick. */
+int64_t
+timer_now_ns (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t ns = ticks * NS_PER_TICK;
+
+  if (tsc_per_tick != 0)
+    ns += (timer_read_tsc () - tick_tsc) * NS_PER_TICK / tsc_per_tick;
+  if (ns < last_now_ns)
+    ns = last_now_ns;
+  else
+    last_now_ns = ns;
+  intr_set_level (old_level);
+
+  return ns;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The current thread is blocked on sleep_list until the timer
+   interrupt handler finds that its wake-up tick has arrived, so
+   a sleeping thread costs nothing while it waits. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  cur->wakeup_tick = timer_ticks () + ticks;
+  list_insert_ordered (&sleep_list, &cur->elem, wakeup_less, NULL);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Initializes timer T as not pending.  T may then be passed to
+   timer_add() and timer_cancel(). */
+void
+timer_setup (struct timer *t) 
+{
+  ASSERT (t != NULL);
+
+  t->func = NULL;
+  t->aux = NULL;
+  t->pending = false;
+}
+
+/* Adds timer T, which must have been initialized with
+   timer_setup(), to call FUNC(AUX) from the timer interrupt
+   handler at tick DEADLINE, or at the next tick if DEADLINE has
+   already passed.  T must not already be pending.
+
+   FUNC runs in an external interrupt context, so it must not
+   sleep and should return quickly.  It may add T again. */
+void
+timer_add (struct timer *t, int64_t deadline, timer_func *func, void *aux) 
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!t->pending);
+  t->deadline = deadline;
+  t->func = func;
+  t->aux = aux;
+  t->pending = true;
+  wheel_insert (t);
+  wheel_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Cancels timer T.  Returns true if T was pending, false if it
+   had already run or been canceled. */
+bool
+timer_cancel (struct timer *t) 
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  was_pending = t->pending;
+  if (was_pending) 
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+      wheel_cnt--;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -164,47 +350,239 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" interrupts saved by tickless idle\n",
+            saved_interrupts);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, replaces the periodic timer
+   interrupt by a single one at the next sleeper's wake-up tick,
+   or as many ticks ahead as the PIT's counter can reach. */
+void
+timer_idle_enter (void) 
+{
+  int max_ticks = UINT16_MAX / TICK_COUNT;
+  int idle_ticks = max_ticks;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_armed || resync_armed)
+    return;
+
+  if (!list_empty (&sleep_list)) 
+    {
+      int64_t next_wakeup = list_entry (list_front (&sleep_list),
+                                        struct thread, elem)->wakeup_tick;
+      if (next_wakeup - ticks < max_ticks)
+        idle_ticks = next_wakeup - ticks;
+    }
+  idle_ticks = wheel_next_tick (ticks + idle_ticks) - ticks;
+  if (idle_ticks <= 1)
+    return;
+
+  /* Channel 0 counts down from TICK_COUNT to 1 in periodic
+     mode, so this tells us how far into the current tick we
+     are.  Ending the countdown on a tick boundary keeps the
+     tick grid intact. */
+  oneshot_start = TICK_COUNT - pit_read_count (0);
+  if (oneshot_start >= TICK_COUNT)
+    return;
+  oneshot_ticks = idle_ticks;
+  oneshot_count = idle_ticks * TICK_COUNT - oneshot_start;
+  pit_start_oneshot (0, oneshot_count);
+  oneshot_armed = true;
+}
+
+/* Called with interrupts off when the CPU stops idling, either
+   because the one-shot timer interrupt arrived or because the
+   idle thread is being switched out.  Accounts for the ticks
+   that passed without a timer interrupt and heads back to
+   periodic mode, by way of a one-shot to the end of the current
+   tick if the countdown had not expired yet. */
+void
+timer_idle_exit (void) 
+{
+  unsigned remaining, elapsed_count;
+  int elapsed_ticks;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!oneshot_armed)
+    return;
+  oneshot_armed = false;
+
+  /* After expiring, the counter wraps around to values above
+     the original count.  In that case the timer interrupt that
+     ends the countdown has arrived or is pending, and it
+     accounts for the last tick itself. */
+  remaining = pit_read_count (0);
+  if (remaining == 0 || remaining > oneshot_count)
+    {
+      elapsed_ticks = oneshot_ticks - 1;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  else
+    {
+      elapsed_count = oneshot_start + oneshot_count - remaining;
+      elapsed_ticks = elapsed_count / TICK_COUNT;
+      pit_start_oneshot (0, TICK_COUNT - elapsed_count % TICK_COUNT);
+      resync_armed = true;
+    }
+
+  /* No sleeper is due before the countdown's last tick, so these
+     ticks need no wake-ups of their own.  tick_tsc moves along
+     with `ticks', so that timer_now_ns() does not count the
+     same time twice before the next timer interrupt. */
+  saved_interrupts += elapsed_ticks;
+  for (; elapsed_ticks > 0; elapsed_ticks--) 
+    {
+      ticks++;
+      tick_tsc += tsc_per_tick;
+      thread_tick_idle ();
+    }
 }
 
-/* Timer interrupt handler. */
+/* Timer interrupt handler.  Wakes up every sleeping thread
+   whose wake-up tick has arrived.  Because sleep_list is sorted,
+   this stops at the first thread that must keep sleeping. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
+  /* Catch up on ticks that went by while tickless idle.  If
+     this interrupt ends the rest of a tick cut short by an early
+     wake-up, it lands on a tick boundary, so periodic mode can
+     resume from here. */
+  timer_idle_exit ();
+  if (resync_armed) 
+    {
+      resync_armed = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+
   ticks++;
+  tick_tsc = timer_read_tsc ();
+  while (!list_empty (&sleep_list)) 
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_tick > ticks)
+        break;
+      list_pop_front (&sleep_list);
+      thread_unblock (t);
+    }
+  while (wheel_tick <= ticks)
+    wheel_advance ();
+  profile_sample (args);
   thread_tick ();
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
+/* Returns true if thread A must wake up before thread B,
+   false otherwise.  Threads with equal wake-up ticks compare
+   equal, so list_insert_ordered() keeps them in FIFO order. */
 static bool
-too_many_loops (unsigned loops) 
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED) 
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait (loops);
+  return a->wakeup_tick < b->wakeup_tick;
+}
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+/* Puts pending timer T into the wheel slot for its deadline,
+   relative to wheel_tick. */
+static void
+wheel_insert (struct timer *t) 
+{
+  int64_t deadline = t->deadline;
+  int64_t delta = deadline - wheel_tick;
+  int level;
+
+  if (delta < 0) 
+    {
+      /* Overdue: run at the next tick processed. */
+      deadline = wheel_tick;
+      delta = 0;
+    }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+  if (delta >= (int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) 
+    {
+      /* Beyond the wheel's reach: wait in the furthest slot. */
+      deadline = wheel_tick + ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+
+  list_push_back (&wheel[level][(deadline >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &t->elem);
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Processes tick wheel_tick: cascades higher levels of the wheel
+   if level 0 has wrapped around, then runs every timer in the
+   level 0 slot for the tick. */
+static void
+wheel_advance (void) 
+{
+  struct list *slot;
+  int level;
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) 
+  for (level = 1; level < WHEEL_LEVELS; level++) 
+    {
+      if (((wheel_tick >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) != 0)
+        break;
+      slot = &wheel[level][(wheel_tick >> (WHEEL_BITS * level))
+                           & WHEEL_MASK];
+      while (!list_empty (slot))
+        wheel_insert (list_entry (list_pop_front (slot),
+                                  struct timer, elem));
+    }
+
+  /* Advance wheel_tick first, so that timers that a callback
+     adds for this tick go into the next slot instead of this
+     one. */
+  slot = &wheel[0][wheel_tick & WHEEL_MASK];
+  wheel_tick++;
+  while (!list_empty (slot)) 
+    {
+      struct timer *t = list_entry (list_pop_front (slot),
+                                    struct timer, elem);
+      t->pending = false;
+      wheel_cnt--;
+      t->func (t->aux);
+    }
+}
+
+/* Returns the first tick, no later than LIMIT, at which the
+   wheel has a timer to run or a slot to cascade, or LIMIT if
+   there is none.  Used to decide how long to stay idle, so LIMIT
+   should be only a few ticks away. */
+static int64_t
+wheel_next_tick (int64_t limit) 
 {
-  while (loops-- > 0)
-    barrier ();
+  int64_t tick;
+
+  if (wheel_cnt == 0)
+    return limit;
+  for (tick = wheel_tick; tick < limit; tick++)
+    if ((tick & WHEEL_MASK) == 0
+        || !list_empty (&wheel[0][tick & WHEEL_MASK]))
+      return tick;
+  return limit;
+}
+
+/* Spins until the TSC has advanced by CYCLES, for implementing
+   brief delays.  Unlike a calibrated loop count, this is not
+   thrown off by code alignment or by interrupts that arrive
+   during the wait. */
+static void
+tsc_wait (uint64_t cycles) 
+{
+  uint64_t start = timer_read_tsc ();
+  while (timer_read_tsc () - start < cycles)
+    asm volatile ("pause");
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -242,5 +620,5 @@ real_time_delay (int64_t num, int32_t denom)
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
   ASSERT (denom % 1000 == 0);
-  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
+  tsc_wait (tsc_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
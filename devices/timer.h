@@ -1,18 +1,39 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If false (default), the timer interrupts TIMER_FREQ times per
+   second even when the CPU is idle.
+   If true, the periodic interrupt is stopped while idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+/* High-resolution time. */
+int64_t timer_now_ns (void);
+
+/* Returns the CPU's time-stamp counter, which counts CPU cycles
+   since reset.  See [IA32-v2b] "RDTSC--Read Time-Stamp Counter". */
+static inline uint64_t
+timer_read_tsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -24,6 +45,30 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* A kernel timer, which calls FUNC(AUX) in the timer interrupt
+   handler once the tick count reaches DEADLINE.  The caller owns
+   the storage for a struct timer, must initialize it with
+   timer_setup() before its first use, and must keep it alive
+   while the timer is pending. */
+typedef void timer_func (void *aux);
+struct timer 
+  {
+    struct list_elem elem;      /* Element in a timing wheel slot. */
+    int64_t deadline;           /* Tick at which to call FUNC. */
+    timer_func *func;           /* Function to call. */
+    void *aux;                  /* Argument for FUNC. */
+    bool pending;               /* Added but not yet run or canceled? */
+  };
+
+/* Kernel timers. */
+void timer_setup (struct timer *);
+void timer_add (struct timer *, int64_t deadline, timer_func *, void *aux);
+bool timer_cancel (struct timer *);
+
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -69,6 +69,76 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask of the bits of the element numbered ELEM_IDX
+   that represent bits START through END - 1 of the bitmap.  The
+   range must overlap the element. */
+static inline elem_type
+range_mask (size_t elem_idx, size_t start, size_t end) 
+{
+  size_t base = elem_idx * ELEM_BITS;
+  size_t lo = start > base ? start - base : 0;
+  size_t hi = end < base + ELEM_BITS ? end - base : ELEM_BITS;
+  elem_type mask = hi - lo < ELEM_BITS
+                   ? ((elem_type) 1 << (hi - lo)) - 1 : (elem_type) -1;
+  return mask << lo;
+}
+
+/* Returns the index of the least significant set bit in X, which
+   must be nonzero.  See [IA32-v2a] "BSF--Bit Scan Forward". */
+static inline int
+bsf (elem_type x) 
+{
+  int idx;
+  asm ("bsfl %1, %0" : "=r" (idx) : "rm" (x));
+  return idx;
+}
+
+/* Returns the number of set bits in X.  The kernel cannot rely on
+   the POPCNT instruction or on libgcc, so this adds up bits in
+   parallel within X. */
+static inline int
+popcount (elem_type x) 
+{
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  x = (x + (x >> 4)) & 0x0f0f0f0f;
+  return (x * 0x01010101) >> 24;
+}
+
+/* Returns element ELEM_IDX of B if VALUE is true, or its
+   complement if VALUE is false, so that bits set to VALUE in B
+   are 1s in the result. */
+static inline elem_type
+elem_value (const struct bitmap *b, size_t elem_idx, bool value) 
+{
+  return value ? b->bits[elem_idx] : ~b->bits[elem_idx];
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value) 
+{
+  size_t idx, last_idx, bit;
+  elem_type bits;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  idx = elem_idx (start);
+  last_idx = elem_cnt (b->bit_cnt) - 1;
+  bits = elem_value (b, idx, value) & ~(bit_mask (start) - 1);
+  while (bits == 0) 
+    {
+      if (idx == last_idx)
+        return b->bit_cnt;
+      bits = elem_value (b, ++idx, value);
+    }
+
+  bit = idx * ELEM_BITS + bsf (bits);
+  return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -214,18 +284,31 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, with elements that lie
+   entirely within the range simply overwritten. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
+  size_t idx;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  if (cnt == 0)
+    return;
+  for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++) 
+    {
+      elem_type mask = range_mask (idx, start, end);
+      if (mask == (elem_type) -1)
+        b->bits[idx] = value ? mask : 0;
+      else if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,16 +316,18 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t idx, value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  if (cnt > 0)
+    for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+      value_cnt += popcount (elem_value (b, idx, value)
+                             & range_mask (idx, start, end));
   return value_cnt;
 }
 
@@ -251,15 +336,17 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
+  size_t idx;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  if (cnt > 0)
+    for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+      if ((elem_value (b, idx, value) & range_mask (idx, start, end)) != 0)
+        return true;
   return false;
 }
 
@@ -292,20 +379,36 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Works a run of VALUE bits at a time: finds the start of the
+   next run, then its end, skipping whole elements that contain
+   no bit of interest, so the cost is proportional to the number
+   of elements and runs examined, independent of CNT. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 0)
+    return start;
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+      while (i <= last) 
+        {
+          size_t end;
+
+          i = find_next (b, i, value);
+          if (i > last)
+            break;
+          end = find_next (b, i, !value);
+          if (end - i >= cnt)
+            return i;
+          i = end;
+        }
     }
   return BITMAP_ERROR;
 }
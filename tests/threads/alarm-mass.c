@@ -0,0 +1,99 @@
+/* Puts 500 threads to sleep at once, for durations spread over
+   ten different wake-up ticks, and verifies that each of them
+   wakes up on or after its wake-up tick.
+
+   Thread statistics are printed before and after the sleep
+   period.  With a blocking timer_sleep() the number of context
+   switches while the threads sleep stays proportional to the
+   number of wake-ups and the CPU spends most of the interval in
+   the idle thread; a timer_sleep() that yields in a loop instead
+   shows hundreds of switches per tick and almost no idle
+   ticks. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 500
+
+/* Information about an individual sleeper. */
+struct mass_sleeper 
+  {
+    int64_t wake_tick;          /* Tick to wake up at. */
+    int64_t woke_tick;          /* Tick actually woken up at. */
+    struct semaphore *done;     /* Upped when the sleeper finishes. */
+  };
+
+static thread_func mass_sleeper;
+
+void
+test_alarm_mass (void) 
+{
+  struct mass_sleeper *sleepers;
+  struct semaphore done;
+  int64_t start;
+  int64_t max_late = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sleepers = malloc (sizeof *sleepers * THREAD_CNT);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+  sema_init (&done, 0);
+
+  msg ("Creating %d threads to sleep until one of 10 wake-up ticks.",
+       THREAD_CNT);
+
+  /* Leave enough time to create all of the threads before the
+     first one is due. */
+  start = timer_ticks () + 100;
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct mass_sleeper *s = &sleepers[i];
+      char name[16];
+
+      s->wake_tick = start + (i % 10 + 1) * 10;
+      s->woke_tick = 0;
+      s->done = &done;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, mass_sleeper, s) == TID_ERROR)
+        fail ("thread_create() failed for sleeper %d", i);
+    }
+
+  thread_print_stats ();
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  thread_print_stats ();
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct mass_sleeper *s = &sleepers[i];
+      if (s->woke_tick < s->wake_tick)
+        fail ("sleeper %d woke up at tick %lld, before tick %lld",
+              i, s->woke_tick, s->wake_tick);
+      if (s->woke_tick - s->wake_tick > max_late)
+        max_late = s->woke_tick - s->wake_tick;
+    }
+  msg ("All %d sleepers woke up, at most %lld ticks late.",
+       THREAD_CNT, max_late);
+
+  free (sleepers);
+  pass ();
+}
+
+/* Sleeper thread. */
+static void
+mass_sleeper (void *s_) 
+{
+  struct mass_sleeper *s = s_;
+
+  timer_sleep (s->wake_tick - timer_ticks ());
+  s->woke_tick = timer_ticks ();
+  sema_up (s->done);
+}
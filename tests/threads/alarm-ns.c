@@ -0,0 +1,95 @@
+/* Checks timer_now_ns() against timer_ticks(): the nanosecond
+   clock must never run backward, must advance within a single
+   timer tick, and must agree with the tick count over a sleep
+   of several ticks.  Also checks that timer_udelay() waits about
+   as long as asked, and that the clock does not jump when the
+   CPU wakes up early from tickless idle. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of back-to-back readings to check for monotonicity. */
+#define READ_CNT 10000
+
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000 * 1000 * 1000 / TIMER_FREQ)
+
+void
+test_alarm_ns (void) 
+{
+  int64_t prev, now, start_ns, start_tick, ticks, ns;
+  enum intr_level old_level;
+  bool old_tickless;
+  int distinct = 0;
+  int i;
+
+  /* Back-to-back readings never decrease, and most of them fall
+     within the same tick, so they must differ from each other
+     more often than the tick count does. */
+  msg ("Reading the clock %d times.", READ_CNT);
+  start_tick = timer_ticks ();
+  prev = timer_now_ns ();
+  for (i = 0; i < READ_CNT; i++) 
+    {
+      now = timer_now_ns ();
+      if (now < prev)
+        fail ("clock went backward from %lld ns to %lld ns", prev, now);
+      if (now != prev)
+        distinct++;
+      prev = now;
+    }
+  if (distinct <= timer_elapsed (start_tick))
+    fail ("only %d distinct readings in %lld ticks",
+          distinct, timer_elapsed (start_tick));
+
+  /* A sleep of 10 ticks lasts 10 ticks of nanoseconds, give or
+     take the partial ticks at either end. */
+  msg ("Sleeping for 10 ticks.");
+  timer_sleep (1);
+  start_tick = timer_ticks ();
+  start_ns = timer_now_ns ();
+  timer_sleep (10);
+  ticks = timer_elapsed (start_tick);
+  ns = timer_now_ns () - start_ns;
+  if (ns < (ticks - 1) * NS_PER_TICK || ns > (ticks + 1) * NS_PER_TICK)
+    fail ("%lld ticks took %lld ns", ticks, ns);
+
+  /* A 1 ms busy-wait lasts about 1 ms. */
+  msg ("Busy-waiting for 1 ms.");
+  start_ns = timer_now_ns ();
+  timer_udelay (1000);
+  ns = timer_now_ns () - start_ns;
+  if (ns < 900 * 1000 || ns > 5 * 1000 * 1000)
+    fail ("1 ms delay took %lld ns", ns);
+
+  /* Going tickless idle and being woken by some other interrupt
+     3 ticks into the countdown, short of the 4 or more ticks
+     that it lasts with nothing sleeping, neither loses nor gains
+     time. */
+  msg ("Waking up early from tickless idle.");
+  old_tickless = timer_tickless;
+  timer_tickless = true;
+  old_level = intr_disable ();
+  start_ns = timer_now_ns ();
+  timer_idle_enter ();
+  timer_mdelay (3 * 1000 / TIMER_FREQ);
+  timer_idle_exit ();
+  now = timer_now_ns ();
+  intr_set_level (old_level);
+  timer_tickless = old_tickless;
+  ns = now - start_ns;
+  if (ns < 2 * NS_PER_TICK || ns > 4 * NS_PER_TICK)
+    fail ("3 ticks of tickless idle took %lld ns", ns);
+
+  /* The clock keeps running afterward. */
+  timer_sleep (2);
+  ns = timer_now_ns () - now;
+  if (ns < NS_PER_TICK || ns > 4 * NS_PER_TICK)
+    fail ("2 ticks after tickless idle took %lld ns", ns);
+
+  pass ();
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-ns) begin
+(alarm-ns) Reading the clock 10000 times.
+(alarm-ns) Sleeping for 10 ticks.
+(alarm-ns) Busy-waiting for 1 ms.
+(alarm-ns) Waking up early from tickless idle.
+(alarm-ns) PASS
+(alarm-ns) end
+EOF
+pass;
@@ -0,0 +1,104 @@
+/* Benchmarks the kernel timer wheel: adds 100,000 timers with
+   deadlines spread over the next 100,000 ticks, cancels every
+   other one, and reports the average cost of each operation.
+   Then checks that a batch of short timers all run, none of them
+   early, and that the long timers can still be canceled.
+
+   With a timing wheel, the cost per add and per cancel does not
+   depend on the number of pending timers. */
+
+#include <stdio.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define TIMER_CNT 100000        /* Number of long timers. */
+#define SHORT_CNT 1000          /* Number of short timers. */
+#define SHORT_TICKS 50          /* Maximum delay of short timers. */
+
+static timer_func short_timer;
+static timer_func long_timer;
+
+static int short_ran;           /* Number of short timers run. */
+static int short_early;         /* Number run before deadline. */
+
+void
+test_alarm_wheel (void) 
+{
+  struct timer *timers, *shorts;
+  int64_t start, now, add_ns, cancel_ns;
+  int i;
+
+  timers = malloc (sizeof *timers * TIMER_CNT);
+  shorts = malloc (sizeof *shorts * SHORT_CNT);
+  if (timers == NULL || shorts == NULL)
+    PANIC ("couldn't allocate memory for test");
+  random_init (0);
+
+  msg ("Adding %d timers.", TIMER_CNT);
+  now = timer_ticks ();
+  start = timer_now_ns ();
+  for (i = 0; i < TIMER_CNT; i++) 
+    {
+      timer_setup (&timers[i]);
+      timer_add (&timers[i], now + 1000 + random_ulong () % TIMER_CNT,
+                 long_timer, NULL);
+    }
+  add_ns = timer_now_ns () - start;
+
+  msg ("Canceling %d timers.", TIMER_CNT / 2);
+  start = timer_now_ns ();
+  for (i = 0; i < TIMER_CNT; i += 2)
+    if (!timer_cancel (&timers[i]))
+      fail ("timer %d was not pending", i);
+  cancel_ns = timer_now_ns () - start;
+
+  msg ("Adding %d timers due within %d ticks.", SHORT_CNT, SHORT_TICKS);
+  now = timer_ticks ();
+  for (i = 0; i < SHORT_CNT; i++) 
+    {
+      timer_setup (&shorts[i]);
+      timer_add (&shorts[i], now + 1 + i % SHORT_TICKS, short_timer,
+                 &shorts[i]);
+    }
+  timer_sleep (SHORT_TICKS + 1);
+  if (short_ran != SHORT_CNT)
+    fail ("%d of %d short timers ran", short_ran, SHORT_CNT);
+  if (short_early != 0)
+    fail ("%d short timers ran early", short_early);
+
+  msg ("Canceling the remaining %d timers.", TIMER_CNT / 2);
+  for (i = 0; i < TIMER_CNT; i++)
+    if (timer_cancel (&timers[i]) != (i % 2 != 0))
+      fail ("timer %d in wrong state", i);
+
+  msg ("%lld ns per add, %lld ns per cancel.",
+       add_ns / TIMER_CNT, cancel_ns / (TIMER_CNT / 2));
+
+  free (shorts);
+  free (timers);
+  pass ();
+}
+
+/* Short timer callback.  Counts the timers that run, and those
+   that run before their deadline. */
+static void
+short_timer (void *t_) 
+{
+  struct timer *t = t_;
+
+  short_ran++;
+  if (timer_ticks () < t->deadline)
+    short_early++;
+}
+
+/* Long timer callback.  Long timers are all canceled before they
+   are due. */
+static void
+long_timer (void *aux UNUSED) 
+{
+  fail ("long timer ran");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary from run to run.
+s/\d+ ns per/N ns per/g foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(alarm-wheel) begin
+(alarm-wheel) Adding 100000 timers.
+(alarm-wheel) Canceling 50000 timers.
+(alarm-wheel) Adding 1000 timers due within 50 ticks.
+(alarm-wheel) Canceling the remaining 50000 timers.
+(alarm-wheel) N ns per add, N ns per cancel.
+(alarm-wheel) PASS
+(alarm-wheel) end
+EOF
+pass;
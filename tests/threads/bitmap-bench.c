@@ -0,0 +1,127 @@
+/* Benchmarks bitmap_scan() and bitmap_count() on a fragmented
+   bitmap of 1M bits, against bit-at-a-time reference versions
+   equivalent to the original implementations, and checks that
+   both give the same answers.
+
+   The bitmap consists of alternating runs of 1 to 15 false bits
+   and 1 to 15 true bits, so that a scan for 16 false bits fails
+   only after examining the whole bitmap, which is the worst case
+   for the reference scan. */
+
+#include <bitmap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+
+#define BIT_CNT (1024 * 1024)   /* Bits in the bitmap. */
+#define RUN_MAX 15              /* Maximum length of a run. */
+
+static size_t ref_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool value);
+static size_t ref_count (const struct bitmap *, size_t start, size_t cnt,
+                         bool value);
+
+void
+test_bitmap_bench (void) 
+{
+  static const size_t scan_cnts[] = {1, 8, RUN_MAX, RUN_MAX + 1};
+  struct bitmap *b;
+  int64_t start, ref_ns, new_ns;
+  size_t ref_idx, new_idx;
+  size_t bit;
+  bool value;
+  size_t i;
+
+  b = bitmap_create (BIT_CNT);
+  if (b == NULL)
+    fail ("couldn't allocate bitmap");
+
+  random_init (0);
+  value = false;
+  for (bit = 0; bit < BIT_CNT; value = !value) 
+    {
+      size_t run = random_ulong () % RUN_MAX + 1;
+      if (run > BIT_CNT - bit)
+        run = BIT_CNT - bit;
+      bitmap_set_multiple (b, bit, run, value);
+      bit += run;
+    }
+
+  for (i = 0; i < sizeof scan_cnts / sizeof *scan_cnts; i++) 
+    {
+      size_t cnt = scan_cnts[i];
+
+      start = timer_now_ns ();
+      ref_idx = ref_scan (b, 0, cnt, false);
+      ref_ns = timer_now_ns () - start;
+
+      start = timer_now_ns ();
+      new_idx = bitmap_scan (b, 0, cnt, false);
+      new_ns = timer_now_ns () - start;
+
+      if (ref_idx != new_idx)
+        fail ("scan for %zu bits: expected %zu, got %zu",
+              cnt, ref_idx, new_idx);
+      msg ("scan for %zu bits: %lld us bit-at-a-time, %lld us by word.",
+           cnt, ref_ns / 1000, new_ns / 1000);
+    }
+
+  start = timer_now_ns ();
+  ref_idx = ref_count (b, 1, BIT_CNT - 2, true);
+  ref_ns = timer_now_ns () - start;
+
+  start = timer_now_ns ();
+  new_idx = bitmap_count (b, 1, BIT_CNT - 2, true);
+  new_ns = timer_now_ns () - start;
+
+  if (ref_idx != new_idx)
+    fail ("count: expected %zu, got %zu", ref_idx, new_idx);
+  msg ("count: %lld us bit-at-a-time, %lld us by word.",
+       ref_ns / 1000, new_ns / 1000);
+
+  bitmap_destroy (b);
+  pass ();
+}
+
+/* Returns true if any of the CNT bits starting at START in B are
+   set to VALUE, testing one bit at a time. */
+static bool
+ref_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      return true;
+  return false;
+}
+
+/* Bit-at-a-time version of bitmap_scan(). */
+static size_t
+ref_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
+{
+  if (cnt <= bitmap_size (b)) 
+    {
+      size_t last = bitmap_size (b) - cnt;
+      size_t i;
+      for (i = start; i <= last; i++)
+        if (!ref_contains (b, i, cnt, !value))
+          return i; 
+    }
+  return BITMAP_ERROR;
+}
+
+/* Bit-at-a-time version of bitmap_count(). */
+static size_t
+ref_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
+{
+  size_t i, value_cnt;
+
+  value_cnt = 0;
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
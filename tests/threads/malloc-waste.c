@@ -0,0 +1,154 @@
+/* Replays an allocation trace modeled on the kernel's own use of
+   malloc() and reports how many bytes were wasted by rounding
+   requests up to block sizes, both with the current size classes
+   and with the powers of 2 that malloc() used to round to.
+
+   Then grows blocks one step at a time with realloc() and
+   reports how often each block stayed in place, checking that
+   the contents survive each move. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+#define LIVE_CNT 256            /* Live allocations in the trace. */
+#define OP_CNT 20000            /* Allocations in the trace. */
+
+/* An object size in the trace and its relative frequency. */
+struct trace_size 
+  {
+    size_t size;                /* Size in bytes, or 0 for a string. */
+    int weight;                 /* Relative frequency. */
+  };
+
+static const struct trace_size trace_sizes[] = 
+  {
+    {0, 30},                    /* File names, command lines. */
+    {8, 10},                    /* struct dir. */
+    {12, 15},                   /* struct file. */
+    {20, 10},                   /* Small list nodes. */
+    {36, 10},                   /* Page table entries. */
+    {40, 8},                    /* Hash elements. */
+    {68, 6},                    /* Process records. */
+    {136, 4},                   /* File descriptor tables. */
+    {512, 4},                   /* Sector buffers. */
+    {536, 3},                   /* struct inode. */
+  };
+
+static void *live[LIVE_CNT];
+
+static size_t random_size (void);
+static size_t pow2_block_size (size_t);
+static void test_waste (void);
+static void test_realloc (size_t start, size_t end, size_t step);
+
+void
+test_malloc_waste (void) 
+{
+  test_waste ();
+  test_realloc (16, 1024, 8);
+  test_realloc (PGSIZE, 16 * PGSIZE, PGSIZE);
+  pass ();
+}
+
+/* Replays the trace and reports wasted bytes. */
+static void
+test_waste (void) 
+{
+  unsigned long long req_bytes = 0, block_bytes = 0, pow2_bytes = 0;
+  int op, i;
+
+  random_init (0);
+  for (op = 0; op < OP_CNT; op++) 
+    {
+      int slot = random_ulong () % LIVE_CNT;
+      size_t size = random_size ();
+
+      free (live[slot]);
+      live[slot] = malloc (size);
+      if (live[slot] == NULL)
+        fail ("malloc of %zu bytes failed", size);
+      memset (live[slot], slot, size);
+
+      req_bytes += size;
+      block_bytes += malloc_usable_size (live[slot]);
+      pow2_bytes += pow2_block_size (size);
+    }
+  for (i = 0; i < LIVE_CNT; i++) 
+    {
+      free (live[i]);
+      live[i] = NULL;
+    }
+
+  msg ("%d allocations, %llu bytes requested.", OP_CNT, req_bytes);
+  msg ("Size classes: %llu bytes allocated, %llu%% wasted.",
+       block_bytes, (block_bytes - req_bytes) * 100 / block_bytes);
+  msg ("Powers of 2: %llu bytes allocated, %llu%% wasted.",
+       pow2_bytes, (pow2_bytes - req_bytes) * 100 / pow2_bytes);
+}
+
+/* Grows a block from START to END bytes, STEP bytes at a time,
+   and reports how many of the reallocations moved it. */
+static void
+test_realloc (size_t start, size_t end, size_t step) 
+{
+  uint8_t *p = malloc (start);
+  size_t size, i;
+  int moves = 0, steps = 0;
+
+  if (p == NULL)
+    fail ("malloc of %zu bytes failed", start);
+  memset (p, 0x5a, start);
+  for (size = start + step; size <= end; size += step) 
+    {
+      uint8_t *q = realloc (p, size);
+      if (q == NULL)
+        fail ("realloc to %zu bytes failed", size);
+      for (i = 0; i < size - step; i++)
+        if (q[i] != 0x5a)
+          fail ("byte %zu lost in realloc to %zu bytes", i, size);
+      memset (q + size - step, 0x5a, step);
+      moves += q != p;
+      steps++;
+      p = q;
+    }
+  free (p);
+
+  msg ("Growing %zu to %zu bytes: %d of %d reallocs moved the block.",
+       start, end, moves, steps);
+}
+
+/* Returns a random size drawn from trace_sizes[]. */
+static size_t
+random_size (void) 
+{
+  const size_t cnt = sizeof trace_sizes / sizeof *trace_sizes;
+  int total = 0, pick;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    total += trace_sizes[i].weight;
+  pick = random_ulong () % total;
+  for (i = 0; pick >= trace_sizes[i].weight; i++)
+    pick -= trace_sizes[i].weight;
+
+  /* Strings are 2 to 128 bytes, including the null terminator,
+     with shorter ones more common. */
+  if (trace_sizes[i].size == 0)
+    return random_ulong () % (random_ulong () % 127 + 1) + 2;
+  return trace_sizes[i].size;
+}
+
+/* Returns the block size that malloc() used before size classes
+   were introduced: a power of 2 no smaller than 16. */
+static size_t
+pow2_block_size (size_t size) 
+{
+  size_t block_size = 16;
+  while (block_size < size)
+    block_size *= 2;
+  return block_size;
+}
@@ -0,0 +1,46 @@
+/* Touches one word in each of PAGE_CNT pages, ROUND_CNT times
+   over, through the kernel's mapping of physical memory, and
+   reports the average number of cycles per touch.  With 4 kB
+   pages, the pages need far more TLB entries than the CPU has;
+   with 4 MB pages, they need only a few.  Run the test with and
+   without the -nopse kernel option to compare. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 2048           /* Pages touched, 8 MB in all. */
+#define ROUND_CNT 16            /* Passes over the pages. */
+#define CACHE_LINE 64           /* Bytes per cache line. */
+
+void
+test_page_touch (void) 
+{
+  uint8_t *pages = palloc_get_multiple (PAL_USER | PAL_ZERO, PAGE_CNT);
+  uint32_t sum = 0;
+  uint64_t start, cycles;
+  int round, i;
+
+  if (pages == NULL)
+    fail ("could not allocate %d pages", PAGE_CNT);
+
+  /* Touch a different cache line in each page, so that the test
+     measures TLB misses rather than cache conflicts. */
+  start = timer_read_tsc ();
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < PAGE_CNT; i++) 
+      {
+        uint32_t *p = (uint32_t *) (pages + i * PGSIZE
+                                    + i * CACHE_LINE % PGSIZE);
+        *p += round;
+        sum += *p;
+      }
+  cycles = timer_read_tsc () - start;
+  palloc_free_multiple (pages, PAGE_CNT);
+
+  msg ("Touched %d pages %d times: %llu cycles per touch (sum %u).",
+       PAGE_CNT, ROUND_CNT, cycles / (PAGE_CNT * ROUND_CNT), sum);
+  pass ();
+}
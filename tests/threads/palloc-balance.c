@@ -0,0 +1,55 @@
+/* Checks that the kernel and user pools lend memory to each
+   other.  Allocates user pages until the user pool is exhausted,
+   which should take it well past its initial half of memory,
+   frees them, and then does the same for the kernel pool, which
+   must take back what it lent. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define MAX_PAGES 4096          /* Most pages tracked. */
+
+static void *pages[MAX_PAGES];
+
+static size_t fill_pool (enum palloc_flags);
+
+void
+test_palloc_balance (void) 
+{
+  size_t half = init_ram_pages / 2;
+  size_t user_cnt, kernel_cnt;
+
+  ASSERT (init_ram_pages <= MAX_PAGES);
+
+  user_cnt = fill_pool (PAL_USER);
+  msg ("User pool grew to %zu pages.", user_cnt);
+  if (user_cnt <= half)
+    fail ("user pool did not grow past half of memory");
+
+  kernel_cnt = fill_pool (0);
+  msg ("Kernel pool grew to %zu pages.", kernel_cnt);
+  if (kernel_cnt <= half)
+    fail ("kernel pool did not grow past half of memory");
+  pass ();
+}
+
+/* Allocates pages with FLAGS until none are left, frees them,
+   and returns how many there were. */
+static size_t
+fill_pool (enum palloc_flags flags) 
+{
+  size_t cnt, i;
+
+  for (cnt = 0; cnt < MAX_PAGES; cnt++) 
+    {
+      pages[cnt] = palloc_get_page (flags);
+      if (pages[cnt] == NULL)
+        break;
+    }
+  for (i = 0; i < cnt; i++)
+    palloc_free_page (pages[i]);
+  return cnt;
+}
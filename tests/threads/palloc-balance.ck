@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Pool sizes depend on the size of the kernel.
+s/grew to \d+ pages/grew to N pages/ foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(palloc-balance) begin
+(palloc-balance) User pool grew to N pages.
+(palloc-balance) Kernel pool grew to N pages.
+(palloc-balance) PASS
+(palloc-balance) end
+EOF
+pass;
@@ -0,0 +1,104 @@
+/* Benchmarks the page allocator under fragmentation.  Keeps up to
+   SLOT_CNT allocations of 1 to 64 pages each from the user pool
+   live at once, and repeatedly either allocates a new run or
+   frees a random live one.  Reports how many allocations failed
+   and the average number of cycles per allocation and free.
+
+   Every allocated page is stamped with its run's slot number and
+   checked when the run is freed, to catch overlapping
+   allocations. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define OP_CNT 10000            /* Number of operations. */
+#define SLOT_CNT 16             /* Maximum live allocations. */
+#define MAX_PAGES 64            /* Maximum pages per allocation. */
+
+/* A live allocation. */
+struct run 
+  {
+    uint8_t *pages;             /* First page, or NULL if unused. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+static void check_run (const struct run *, int slot);
+
+void
+test_palloc_bench (void) 
+{
+  struct run runs[SLOT_CNT];
+  uint64_t alloc_cycles = 0, free_cycles = 0;
+  int alloc_cnt = 0, fail_cnt = 0, free_cnt = 0;
+  int op, i;
+
+  for (i = 0; i < SLOT_CNT; i++)
+    runs[i].pages = NULL;
+
+  msg ("Performing %d random allocations and frees of 1 to %d pages.",
+       OP_CNT, MAX_PAGES);
+  random_init (0);
+  for (op = 0; op < OP_CNT; op++) 
+    {
+      int slot = random_ulong () % SLOT_CNT;
+      struct run *r = &runs[slot];
+      uint64_t start;
+
+      if (r->pages == NULL) 
+        {
+          size_t page_cnt = random_ulong () % MAX_PAGES + 1;
+
+          start = timer_read_tsc ();
+          r->pages = palloc_get_multiple (PAL_USER, page_cnt);
+          alloc_cycles += timer_read_tsc () - start;
+          alloc_cnt++;
+
+          if (r->pages == NULL)
+            fail_cnt++;
+          else 
+            {
+              r->page_cnt = page_cnt;
+              for (i = 0; i < (int) page_cnt; i++)
+                r->pages[i * PGSIZE] = slot;
+            }
+        }
+      else 
+        {
+          check_run (r, slot);
+          start = timer_read_tsc ();
+          palloc_free_multiple (r->pages, r->page_cnt);
+          free_cycles += timer_read_tsc () - start;
+          free_cnt++;
+          r->pages = NULL;
+        }
+    }
+  for (i = 0; i < SLOT_CNT; i++)
+    if (runs[i].pages != NULL) 
+      {
+        check_run (&runs[i], i);
+        palloc_free_multiple (runs[i].pages, runs[i].page_cnt);
+      }
+
+  msg ("%d of %d allocations failed (%d%%).",
+       fail_cnt, alloc_cnt, fail_cnt * 100 / alloc_cnt);
+  msg ("%llu cycles per allocation, %llu cycles per free.",
+       alloc_cycles / alloc_cnt, free_cycles / (free_cnt ? free_cnt : 1));
+  pass ();
+}
+
+/* Checks that no other allocation has overwritten the stamps in
+   R, which was allocated into SLOT. */
+static void
+check_run (const struct run *r, int slot) 
+{
+  size_t i;
+
+  for (i = 0; i < r->page_cnt; i++)
+    if (r->pages[i * PGSIZE] != slot)
+      fail ("page %zu of run in slot %d overwritten", i, slot);
+}
@@ -0,0 +1,62 @@
+/* Checks that pages obtained with PAL_ZERO are zeroed, and
+   compares the time to obtain them from the stash of pages that
+   the idle thread zeroes in advance with the time to obtain them
+   once the stash is exhausted. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 128            /* Pages allocated per round. */
+#define BATCH_CNT 16            /* Pages timed at start and end. */
+
+static uint8_t *pages[PAGE_CNT];
+
+void
+test_palloc_zero (void) 
+{
+  uint64_t first_cycles = 0, last_cycles = 0;
+  int i, j;
+
+  /* Dirty some pages and free them, then let the idle thread
+     refill the stash. */
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      pages[i] = palloc_get_page (0);
+      if (pages[i] == NULL)
+        fail ("palloc_get_page failed");
+      for (j = 0; j < PGSIZE; j++)
+        pages[i][j] = 0x5a;
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+  timer_sleep (10);
+
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      uint64_t start = timer_read_tsc ();
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (i < BATCH_CNT)
+        first_cycles += timer_read_tsc () - start;
+      else if (i >= PAGE_CNT - BATCH_CNT)
+        last_cycles += timer_read_tsc () - start;
+      if (pages[i] == NULL)
+        fail ("palloc_get_page failed");
+    }
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      for (j = 0; j < PGSIZE; j++)
+        if (pages[i][j] != 0)
+          fail ("byte %d of page %d is not zero", j, i);
+      palloc_free_page (pages[i]);
+    }
+
+  msg ("First %d zeroed pages: %llu cycles each.",
+       BATCH_CNT, first_cycles / BATCH_CNT);
+  msg ("Last %d zeroed pages: %llu cycles each.",
+       BATCH_CNT, last_cycles / BATCH_CNT);
+  pass ();
+}
@@ -0,0 +1,98 @@
+/* Measures the cost of a scheduling decision as the run queue
+   grows.  For each of 1, 64, and 1000 "filler" threads, spread
+   across priorities below the main thread's, the main thread and
+   a partner of equal priority yield to each other repeatedly
+   while all of the fillers sit in the run queue.  Reports the
+   average number of CPU cycles per thread_yield(), which
+   includes one call to schedule() and one context switch.
+
+   With a run queue that finds the highest-priority thread in
+   constant time, the cost should not depend on the number of
+   fillers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define YIELD_CNT 10000
+
+/* State shared with the partner thread. */
+struct bench 
+  {
+    bool stop;                  /* Tells the partner to exit. */
+    struct semaphore done;      /* Upped by each exiting thread. */
+  };
+
+static thread_func partner_thread;
+static thread_func filler_thread;
+static void measure (int filler_cnt);
+
+void
+test_priority_bench (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  measure (1);
+  measure (64);
+  measure (1000);
+  pass ();
+}
+
+/* Times YIELD_CNT yields between the main thread and a partner
+   with FILLER_CNT lower-priority threads in the run queue. */
+static void
+measure (int filler_cnt) 
+{
+  struct bench b;
+  uint64_t start, cycles;
+  int i;
+
+  b.stop = false;
+  sema_init (&b.done, 0);
+
+  for (i = 0; i < filler_cnt; i++) 
+    {
+      int priority = PRI_MIN + 1 + i % (PRI_DEFAULT - PRI_MIN - 1);
+      if (thread_create ("filler", priority, filler_thread, &b) == TID_ERROR)
+        fail ("thread_create() failed for filler %d", i);
+    }
+  thread_create ("partner", PRI_DEFAULT, partner_thread, &b);
+
+  start = timer_read_tsc ();
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield ();
+  cycles = timer_read_tsc () - start;
+
+  /* Let the partner exit, then block so that the fillers run
+     and exit too. */
+  b.stop = true;
+  for (i = 0; i < filler_cnt + 1; i++)
+    sema_down (&b.done);
+
+  msg ("%4d ready threads: %llu cycles per yield",
+       filler_cnt, cycles / (2 * YIELD_CNT));
+}
+
+/* Yields to the main thread until told to stop. */
+static void
+partner_thread (void *b_) 
+{
+  struct bench *b = b_;
+
+  while (!b->stop) 
+    thread_yield ();
+  sema_up (&b->done);
+}
+
+/* Sits in the run queue until the main thread blocks. */
+static void
+filler_thread (void *b_) 
+{
+  struct bench *b = b_;
+
+  sema_up (&b->done);
+}
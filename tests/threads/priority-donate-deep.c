@@ -0,0 +1,157 @@
+/* Stress test for priority donation through long lock chains.
+
+   In each of several rounds, the main thread drops to PRI_MIN
+   and acquires lock 0 and a "side" lock.  It then creates
+   threads 1 through 7, where thread i acquires lock i and then
+   blocks on lock i - 1, held by thread i - 1 (or by the main
+   thread, for lock 0).  A top donor then blocks on lock 7, so
+   its priority has to flow through all 8 locks to reach the
+   main thread.  A side donor of even higher priority then
+   blocks on the side lock, to check that a thread holding
+   several locks keeps the maximum donation across all of them.
+
+   The main thread checks its priority after each step, then
+   releases both locks and verifies that the chain unwinds in
+   order and that every thread in it ran with the donated
+   priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define CHAIN_DEPTH 8           /* Number of locks in a chain. */
+#define ROUND_CNT 10            /* Number of rounds. */
+
+/* State of one round. */
+struct chain 
+  {
+    struct lock locks[CHAIN_DEPTH];     /* Chain of locks. */
+    struct lock side_lock;              /* Second lock held by main. */
+    int top_priority;                   /* Priority of top donor. */
+    int order[CHAIN_DEPTH];             /* Ids in order of acquisition. */
+    int order_cnt;                      /* Number of entries in order. */
+  };
+
+/* One thread in the chain. */
+struct link 
+  {
+    struct chain *chain;        /* Round this thread belongs to. */
+    int id;                     /* 1...CHAIN_DEPTH - 1, or top donor. */
+    struct lock *hold;          /* Lock to hold, or null. */
+    struct lock *wait;          /* Lock to block on. */
+  };
+
+static thread_func link_thread;
+static thread_func side_thread;
+static void check_priority (int expected, const char *when);
+
+void
+test_priority_donate_deep (void) 
+{
+  struct chain chain;
+  struct link links[CHAIN_DEPTH];
+  int round, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      thread_set_priority (PRI_MIN);
+
+      for (i = 0; i < CHAIN_DEPTH; i++)
+        lock_init (&chain.locks[i]);
+      lock_init (&chain.side_lock);
+      chain.top_priority = PRI_DEFAULT + round;
+      chain.order_cnt = 0;
+
+      lock_acquire (&chain.locks[0]);
+      lock_acquire (&chain.side_lock);
+
+      /* Build the chain.  Each thread preempts us, takes its
+         lock, and blocks on the previous one. */
+      for (i = 1; i < CHAIN_DEPTH; i++) 
+        {
+          links[i].chain = &chain;
+          links[i].id = i;
+          links[i].hold = &chain.locks[i];
+          links[i].wait = &chain.locks[i - 1];
+          thread_create ("link", PRI_MIN + i, link_thread, &links[i]);
+          check_priority (PRI_MIN + i, "after adding a link");
+        }
+
+      /* Donate through all CHAIN_DEPTH locks. */
+      links[0].chain = &chain;
+      links[0].id = CHAIN_DEPTH;
+      links[0].hold = NULL;
+      links[0].wait = &chain.locks[CHAIN_DEPTH - 1];
+      thread_create ("top", chain.top_priority, link_thread, &links[0]);
+      check_priority (chain.top_priority, "after top donation");
+
+      /* Donate through the side lock as well. */
+      thread_create ("side", chain.top_priority + 1, side_thread, &chain);
+      check_priority (chain.top_priority + 1, "after side donation");
+
+      lock_release (&chain.side_lock);
+      check_priority (chain.top_priority, "after releasing side lock");
+
+      /* Unwind the chain. */
+      lock_release (&chain.locks[0]);
+      check_priority (PRI_MIN, "after releasing chain");
+
+      if (chain.order_cnt != CHAIN_DEPTH)
+        fail ("round %d: %d of %d links ran", round, chain.order_cnt,
+              CHAIN_DEPTH);
+      for (i = 0; i < CHAIN_DEPTH; i++)
+        if (chain.order[i] != i + 1)
+          fail ("round %d: link %d acquired its lock in position %d",
+                round, chain.order[i], i);
+    }
+
+  msg ("%d rounds of %d-deep donation chains passed.",
+       ROUND_CNT, CHAIN_DEPTH);
+  pass ();
+}
+
+/* Fails the test unless the current thread's priority is
+   EXPECTED. */
+static void
+check_priority (int expected, const char *when) 
+{
+  int actual = thread_get_priority ();
+  if (actual != expected)
+    fail ("%s: %s has priority %d, expected %d",
+          when, thread_name (), actual, expected);
+}
+
+/* Thread in the chain.  Runs with the top donor's priority once
+   it gets the lock it waits for. */
+static void
+link_thread (void *link_) 
+{
+  struct link *link = link_;
+  struct chain *chain = link->chain;
+
+  if (link->hold != NULL)
+    lock_acquire (link->hold);
+  lock_acquire (link->wait);
+
+  check_priority (chain->top_priority, "link got lock");
+  chain->order[chain->order_cnt++] = link->id;
+
+  lock_release (link->wait);
+  if (link->hold != NULL)
+    lock_release (link->hold);
+}
+
+/* Briefly acquires the side lock. */
+static void
+side_thread (void *chain_) 
+{
+  struct chain *chain = chain_;
+
+  lock_acquire (&chain->side_lock);
+  lock_release (&chain->side_lock);
+}
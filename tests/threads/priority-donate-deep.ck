@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-deep) begin
+(priority-donate-deep) 10 rounds of 8-deep donation chains passed.
+(priority-donate-deep) PASS
+(priority-donate-deep) end
+EOF
+pass;
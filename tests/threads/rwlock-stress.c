@@ -0,0 +1,200 @@
+/* Exercises reader-writer locks.
+
+   First, compares throughput against a plain lock: several
+   readers each hold the lock across a one-tick sleep, standing
+   in for I/O.  With a struct lock the readers take turns, but
+   with a struct rwlock they all sleep at once.
+
+   Second, checks that a writer waiting behind a reader goes
+   ahead of a reader that arrives after it.
+
+   Third, runs readers and writers at several priorities against
+   a shared pair of counters that writers update with a sleep in
+   between, and checks that readers never see them disagree and
+   that no writer ever shares the lock. */
+
+#include <stdio.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 8            /* Number of reader threads. */
+#define WRITER_CNT 2            /* Number of writer threads. */
+#define ITER_CNT 5              /* Critical sections per thread. */
+
+static struct rwlock rwlock;
+static struct lock lock;
+static struct semaphore done;
+
+static thread_func lock_reader;
+static thread_func rw_reader;
+static thread_func order_thread;
+static thread_func stress_reader;
+static thread_func stress_writer;
+
+static int64_t run_threads (thread_func *, int cnt);
+
+void
+test_rwlock_stress (void) 
+{
+  int64_t lock_ticks, rw_ticks;
+  int order[2];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rw_init (&rwlock);
+  lock_init (&lock);
+  sema_init (&done, 0);
+
+  msg ("%d readers, %d sleeps each, with a lock.", READER_CNT, ITER_CNT);
+  lock_ticks = run_threads (lock_reader, READER_CNT);
+  msg ("%d readers, %d sleeps each, with a rwlock.", READER_CNT, ITER_CNT);
+  rw_ticks = run_threads (rw_reader, READER_CNT);
+  msg ("Lock took %lld ticks, rwlock took %lld ticks.",
+       lock_ticks, rw_ticks);
+  if (rw_ticks * 2 > lock_ticks)
+    fail ("readers did not hold the rwlock concurrently");
+
+  msg ("Queuing a writer, then a reader, behind a reader.");
+  rw_read_acquire (&rwlock);
+  order[0] = order[1] = 0;
+  thread_create ("writer", PRI_DEFAULT + 1, order_thread, &order[0]);
+  thread_create ("reader", PRI_DEFAULT + 1, order_thread, &order[1]);
+  rw_read_release (&rwlock);
+  sema_down (&done);
+  sema_down (&done);
+  if (order[0] != 1 || order[1] != 2)
+    fail ("writer finished %d, reader finished %d", order[0], order[1]);
+
+  msg ("%d readers and %d writers at varying priorities.",
+       READER_CNT, WRITER_CNT);
+  random_init (0);
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT - 1 + i % 3, stress_reader, NULL);
+  for (i = 0; i < WRITER_CNT; i++)
+    thread_create ("writer", PRI_DEFAULT - 1 + i % 3, stress_writer, NULL);
+  for (i = 0; i < READER_CNT + WRITER_CNT; i++)
+    sema_down (&done);
+
+  pass ();
+}
+
+/* Runs CNT threads that execute FUNC and returns the number of
+   ticks until all of them finish. */
+static int64_t
+run_threads (thread_func *func, int cnt) 
+{
+  int64_t start = timer_ticks ();
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    thread_create ("reader", PRI_DEFAULT, func, NULL);
+  for (i = 0; i < cnt; i++)
+    sema_down (&done);
+  return timer_elapsed (start);
+}
+
+/* Reader that holds a lock across each sleep. */
+static void
+lock_reader (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      lock_acquire (&lock);
+      timer_sleep (1);
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
+
+/* Reader that holds RWLOCK for reading across each sleep. */
+static void
+rw_reader (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      rw_read_acquire (&rwlock);
+      timer_sleep (1);
+      rw_read_release (&rwlock);
+    }
+  sema_up (&done);
+}
+
+/* Takes RWLOCK for writing if ORDER_ points to the first element
+   of the order array, otherwise for reading, and records in
+   *ORDER_ the order in which it got the lock. */
+static void
+order_thread (void *order_) 
+{
+  static int next_order;
+  int *order = order_;
+  bool writer = thread_name ()[0] == 'w';
+
+  if (writer)
+    rw_write_acquire (&rwlock);
+  else
+    rw_read_acquire (&rwlock);
+  *order = ++next_order;
+  if (writer)
+    rw_write_release (&rwlock);
+  else
+    rw_read_release (&rwlock);
+  sema_up (&done);
+}
+
+/* Data shared by stress readers and writers. */
+static int active_readers, active_writers;
+static int counter_a, counter_b;
+
+/* Reader for the stress test. */
+static void
+stress_reader (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT * 4; i++) 
+    {
+      rw_read_acquire (&rwlock);
+      active_readers++;
+      if (active_writers != 0)
+        fail ("reader shares lock with a writer");
+      if (counter_a != counter_b)
+        fail ("reader sees %d != %d", counter_a, counter_b);
+      timer_sleep (random_ulong () % 2);
+      active_readers--;
+      rw_read_release (&rwlock);
+      thread_yield ();
+    }
+  sema_up (&done);
+}
+
+/* Writer for the stress test. */
+static void
+stress_writer (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT * 4; i++) 
+    {
+      rw_write_acquire (&rwlock);
+      if (active_readers != 0 || active_writers != 0)
+        fail ("writer shares lock");
+      active_writers++;
+      counter_a++;
+      timer_sleep (random_ulong () % 2);
+      counter_b++;
+      active_writers--;
+      rw_write_release (&rwlock);
+      timer_sleep (1);
+    }
+  sema_up (&done);
+}
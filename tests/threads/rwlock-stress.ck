@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary from run to run.
+s/took \d+ ticks/took N ticks/g foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(rwlock-stress) begin
+(rwlock-stress) 8 readers, 5 sleeps each, with a lock.
+(rwlock-stress) 8 readers, 5 sleeps each, with a rwlock.
+(rwlock-stress) Lock took N ticks, rwlock took N ticks.
+(rwlock-stress) Queuing a writer, then a reader, behind a reader.
+(rwlock-stress) 8 readers and 2 writers at varying priorities.
+(rwlock-stress) PASS
+(rwlock-stress) end
+EOF
+pass;
@@ -0,0 +1,153 @@
+/* Compares slab caches against malloc() for objects the size of
+   the file system's struct dir, struct file, and struct inode.
+   For each size, allocates OBJ_CNT objects with calloc() and
+   then with kmem_cache_alloc(), and reports the average number
+   of cycles per allocation and the memory each approach used.
+
+   Also checks that objects are distinct and aligned, and that a
+   cache's constructor runs once per object and that the
+   constructed state survives a free and reallocation. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define OBJ_CNT 500             /* Objects allocated per size. */
+#define CTOR_MAGIC 0x12345678   /* Value set by constructor. */
+
+/* An object size to measure. */
+struct bench 
+  {
+    const char *name;           /* Name of the cache. */
+    size_t size;                /* Object size. */
+    size_t align;               /* Object alignment. */
+  };
+
+static const struct bench benches[] = 
+  {
+    {"dir", 8, 0},
+    {"file", 12, 0},
+    {"inode", 536, CACHE_LINE_SIZE},
+  };
+
+static void *objs[OBJ_CNT];
+static int ctor_cnt;
+
+static size_t malloc_block_size (size_t);
+static void run_bench (const struct bench *);
+static void test_ctor (void);
+
+void
+test_slab_bench (void) 
+{
+  size_t i;
+
+  for (i = 0; i < sizeof benches / sizeof *benches; i++)
+    run_bench (&benches[i]);
+  test_ctor ();
+  pass ();
+}
+
+/* Measures allocation time and memory use for B. */
+static void
+run_bench (const struct bench *b) 
+{
+  struct kmem_cache *c;
+  uint64_t start, calloc_cycles, slab_cycles;
+  size_t malloc_bytes, slab_bytes;
+  int i, j;
+
+  /* Time calloc(), as the file system used to. */
+  start = timer_read_tsc ();
+  for (i = 0; i < OBJ_CNT; i++)
+    if ((objs[i] = calloc (1, b->size)) == NULL)
+      fail ("calloc of %zu bytes failed", b->size);
+  calloc_cycles = timer_read_tsc () - start;
+  for (i = 0; i < OBJ_CNT; i++)
+    free (objs[i]);
+  malloc_bytes = OBJ_CNT * malloc_block_size (b->size);
+
+  /* Time the slab cache. */
+  c = kmem_cache_create (b->name, b->size, b->align, NULL);
+  if (c == NULL)
+    fail ("kmem_cache_create failed for %s", b->name);
+  start = timer_read_tsc ();
+  for (i = 0; i < OBJ_CNT; i++)
+    if ((objs[i] = kmem_cache_alloc (c)) == NULL)
+      fail ("kmem_cache_alloc failed for %s", b->name);
+  slab_cycles = timer_read_tsc () - start;
+  slab_bytes = c->slab_cnt * PGSIZE;
+
+  /* Check that objects are aligned and do not overlap. */
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      if (b->align != 0 && (uintptr_t) objs[i] % b->align != 0)
+        fail ("%s object %p misaligned", b->name, objs[i]);
+      memset (objs[i], i & 0xff, b->size);
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    for (j = 0; j < (int) b->size; j++)
+      if (((uint8_t *) objs[i])[j] != (i & 0xff))
+        fail ("%s object %d overwritten", b->name, i);
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+
+  msg ("%s: calloc %llu cycles, %zu bytes; slab %llu cycles, %zu bytes.",
+       b->name, calloc_cycles / OBJ_CNT, malloc_bytes,
+       slab_cycles / OBJ_CNT, slab_bytes);
+}
+
+/* Constructor for test_ctor(). */
+static void
+ctor (void *obj) 
+{
+  *(unsigned *) obj = CTOR_MAGIC;
+  ctor_cnt++;
+}
+
+/* Checks that constructed state is preserved across reuse. */
+static void
+test_ctor (void) 
+{
+  struct kmem_cache *c;
+  int i;
+
+  c = kmem_cache_create ("ctor", 32, 0, ctor);
+  if (c == NULL)
+    fail ("kmem_cache_create failed for ctor");
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL || *(unsigned *) objs[i] != CTOR_MAGIC)
+        fail ("object %d not constructed", i);
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL || *(unsigned *) objs[i] != CTOR_MAGIC)
+        fail ("reused object %d not constructed", i);
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+  if (ctor_cnt != (int) (c->slab_create_cnt * c->objs_per_slab))
+    fail ("constructor ran %d times for %u slabs of %zu objects",
+          ctor_cnt, c->slab_create_cnt, c->objs_per_slab);
+  msg ("Constructor ran once per object.");
+}
+
+/* Returns the size of the block that malloc() uses for a request
+   of SIZE bytes, which is a power of 2 no smaller than 16. */
+static size_t
+malloc_block_size (size_t size) 
+{
+  size_t block_size = 16;
+  while (block_size < size)
+    block_size *= 2;
+  return block_size;
+}
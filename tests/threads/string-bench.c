@@ -0,0 +1,129 @@
+/* Measures the speed of memcpy(), memmove(), memset(), memcmp(),
+   and memchr() on blocks of 16 bytes, 512 bytes (a disk sector),
+   and 4 kB (a page), and reports cycles per byte.
+
+   Also checks each function's results against simple byte-wise
+   loops, at every combination of source and destination
+   alignment. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define ITER_CNT 1000           /* Calls timed per function and size. */
+#define CHECK_SIZE 100          /* Block size for correctness checks. */
+
+static uint8_t buf_a[PGSIZE + 64];
+static uint8_t buf_b[PGSIZE + 64];
+
+static const size_t sizes[] = {16, 512, PGSIZE};
+
+static void check_functions (void);
+static void report (const char *name, size_t size, uint64_t cycles);
+
+void
+test_string_bench (void) 
+{
+  size_t i;
+  int j;
+
+  check_functions ();
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++) 
+    {
+      size_t size = sizes[i];
+      volatile int sink = 0;
+      uint64_t start;
+
+      memset (buf_a, 'a', sizeof buf_a);
+      memset (buf_b, 'a', sizeof buf_b);
+
+      start = timer_read_tsc ();
+      for (j = 0; j < ITER_CNT; j++)
+        memcpy (buf_b, buf_a, size);
+      report ("memcpy", size, timer_read_tsc () - start);
+
+      start = timer_read_tsc ();
+      for (j = 0; j < ITER_CNT; j++)
+        memmove (buf_a + 4, buf_a, size);
+      report ("memmove", size, timer_read_tsc () - start);
+
+      start = timer_read_tsc ();
+      for (j = 0; j < ITER_CNT; j++)
+        memset (buf_b, 'a', size);
+      report ("memset", size, timer_read_tsc () - start);
+
+      memset (buf_a, 'a', sizeof buf_a);
+      start = timer_read_tsc ();
+      for (j = 0; j < ITER_CNT; j++)
+        sink += memcmp (buf_a, buf_b, size);
+      report ("memcmp", size, timer_read_tsc () - start);
+
+      start = timer_read_tsc ();
+      for (j = 0; j < ITER_CNT; j++)
+        sink += memchr (buf_a, 'z', size) != NULL;
+      report ("memchr", size, timer_read_tsc () - start);
+    }
+  pass ();
+}
+
+/* Checks each function against a byte-wise loop at every
+   alignment of its arguments. */
+static void
+check_functions (void) 
+{
+  int src_ofs, dst_ofs, i;
+
+  for (src_ofs = 0; src_ofs < 8; src_ofs++)
+    for (dst_ofs = 0; dst_ofs < 8; dst_ofs++) 
+      {
+        uint8_t *src = buf_a + src_ofs;
+        uint8_t *dst = buf_b + dst_ofs;
+
+        for (i = 0; i < CHECK_SIZE; i++)
+          src[i] = i * 7 + src_ofs;
+
+        memcpy (dst, src, CHECK_SIZE);
+        for (i = 0; i < CHECK_SIZE; i++)
+          if (dst[i] != src[i])
+            fail ("memcpy: byte %d wrong at offsets %d, %d",
+                  i, src_ofs, dst_ofs);
+
+        if (memcmp (dst, src, CHECK_SIZE) != 0)
+          fail ("memcmp: equal blocks differ at offsets %d, %d",
+                src_ofs, dst_ofs);
+        dst[CHECK_SIZE - 1 - dst_ofs]++;
+        if (memcmp (dst, src, CHECK_SIZE) <= 0)
+          fail ("memcmp: wrong sign at offsets %d, %d", src_ofs, dst_ofs);
+
+        if (memchr (src, src[CHECK_SIZE - 1 - dst_ofs], CHECK_SIZE)
+            != src + CHECK_SIZE - 1 - dst_ofs)
+          fail ("memchr: wrong byte found at offset %d", src_ofs);
+
+        memset (dst, dst_ofs, CHECK_SIZE);
+        for (i = 0; i < CHECK_SIZE; i++)
+          if (dst[i] != dst_ofs)
+            fail ("memset: byte %d wrong at offset %d", i, dst_ofs);
+
+        /* Overlapping moves in both directions. */
+        for (i = 0; i < CHECK_SIZE + 8; i++)
+          buf_b[i] = i;
+        memmove (buf_b + dst_ofs, buf_b + src_ofs, CHECK_SIZE);
+        for (i = 0; i < CHECK_SIZE; i++)
+          if (buf_b[dst_ofs + i] != src_ofs + i)
+            fail ("memmove: byte %d wrong at offsets %d, %d",
+                  i, src_ofs, dst_ofs);
+      }
+}
+
+/* Reports CYCLES taken by ITER_CNT calls to NAME on blocks of
+   SIZE bytes, in hundredths of a cycle per byte. */
+static void
+report (const char *name, size_t size, uint64_t cycles) 
+{
+  unsigned per_byte = cycles * 100 / ITER_CNT / size;
+  msg ("%s %4zu bytes: %u.%02u cycles/byte.",
+       name, size, per_byte / 100, per_byte % 100);
+}
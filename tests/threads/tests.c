@@ -17,6 +17,9 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-mass", test_alarm_mass},
+    {"alarm-ns", test_alarm_ns},
+    {"alarm-wheel", test_alarm_wheel},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,10 +28,21 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-deep", test_priority_donate_deep},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-bench", test_priority_bench},
+    {"rwlock-stress", test_rwlock_stress},
+    {"bitmap-bench", test_bitmap_bench},
+    {"palloc-bench", test_palloc_bench},
+    {"palloc-zero", test_palloc_zero},
+    {"palloc-balance", test_palloc_balance},
+    {"slab-bench", test_slab_bench},
+    {"malloc-waste", test_malloc_waste},
+    {"string-bench", test_string_bench},
+    {"page-touch", test_page_touch},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
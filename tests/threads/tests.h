@@ -11,6 +11,9 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_mass;
+extern test_func test_alarm_ns;
+extern test_func test_alarm_wheel;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,10 +22,21 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_deep;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_bench;
+extern test_func test_rwlock_stress;
+extern test_func test_bitmap_bench;
+extern test_func test_palloc_bench;
+extern test_func test_palloc_zero;
+extern test_func test_palloc_balance;
+extern test_func test_slab_bench;
+extern test_func test_malloc_waste;
+extern test_func test_string_bench;
+extern test_func test_page_touch;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
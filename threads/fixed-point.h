@@ -0,0 +1,89 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic, as used by the 4.4BSD
+   scheduler in thread.c.
+
+   A fixed_t holds a real number X as the integer X * FP_ONE, so
+   that it has 17 integer bits (including the sign) and 14
+   fractional bits.  Adding and subtracting fixed_t values, and
+   multiplying or dividing them by integers, are ordinary integer
+   operations.  Multiplying or dividing two fixed_t values needs
+   a 64-bit intermediate.  These are done with single IA-32
+   instructions, so that none of these functions calls into the
+   64-bit division routines in lib/arithmetic.c, which is
+   important for use in the timer interrupt handler. */
+
+typedef int32_t fixed_t;
+
+#define FP_SHIFT 14                     /* Number of fraction bits. */
+#define FP_ONE (1 << FP_SHIFT)          /* 1.0 as a fixed_t. */
+
+/* Returns integer N as a fixed_t. */
+static inline fixed_t
+fp_from_int (int n) 
+{
+  return n * FP_ONE;
+}
+
+/* Returns X rounded toward zero to an integer. */
+static inline int
+fp_trunc (fixed_t x) 
+{
+  return x / FP_ONE;
+}
+
+/* Returns X rounded to the nearest integer. */
+static inline int
+fp_round (fixed_t x) 
+{
+  return (x >= 0 ? x + FP_ONE / 2 : x - FP_ONE / 2) / FP_ONE;
+}
+
+/* Returns X * Y.  The 64-bit product is formed by a single
+   one-operand IMUL. */
+static inline fixed_t
+fp_mul (fixed_t x, fixed_t y) 
+{
+  return ((int64_t) x * y) >> FP_SHIFT;
+}
+
+/* Returns X / Y.  Y must be nonzero and the quotient must be
+   representable as a fixed_t.  The 64-bit dividend is divided by
+   a single IDIV.  See [IA32-v2a] "IDIV--Signed Divide". */
+static inline fixed_t
+fp_div (fixed_t x, fixed_t y) 
+{
+  int64_t n = (int64_t) x << FP_SHIFT;
+  int32_t quotient, remainder;
+
+  asm ("idivl %4"
+       : "=a" (quotient), "=d" (remainder)
+       : "0" ((int32_t) n), "1" ((int32_t) (n >> 32)), "rm" (y));
+  return quotient;
+}
+
+/* Returns X * N, for integer N. */
+static inline fixed_t
+fp_mul_int (fixed_t x, int n) 
+{
+  return x * n;
+}
+
+/* Returns X / N, for nonzero integer N. */
+static inline fixed_t
+fp_div_int (fixed_t x, int n) 
+{
+  return x / n;
+}
+
+/* Returns X + N, for integer N. */
+static inline fixed_t
+fp_add_int (fixed_t x, int n) 
+{
+  return x + n * FP_ONE;
+}
+
+#endif /* threads/fixed-point.h */
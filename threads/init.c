@@ -19,7 +19,9 @@
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
 #ifdef USERPROG
@@ -37,6 +39,11 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -57,8 +64,18 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -nopse: Map kernel memory with 4 kB pages only? */
+static bool no_large_pages;
+
+/* CPUID feature flag for 4 MB pages, in EDX of leaf 1. */
+#define CPUID_PSE 0x00000008
+
+/* CR4 flag that enables 4 MB pages. */
+#define CR4_PSE 0x00000010
+
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -96,6 +113,9 @@ main (void)
 
   /* Initialize memory system. */
   palloc_init (user_page_limit);
+#ifdef MEM_TRACK
+  memtrack_init ();
+#endif
   malloc_init ();
   paging_init ();
 
@@ -114,6 +134,10 @@ main (void)
   exception_init ();
   syscall_init ();
 #endif
+#ifdef VM
+  page_init ();
+  frame_init ();
+#endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
@@ -126,6 +150,9 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+#endif
 
   printf ("Boot complete.\n");
   
@@ -153,14 +180,31 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports them, each 4 MB region of RAM is mapped
+   with a single 4 MB page, which saves a page table and uses one
+   TLB entry instead of 1,024.  A region that holds kernel text,
+   which must be read-only, or that extends past the end of RAM
+   is still mapped with 4 kB pages. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  size_t large_cnt = 0, pt_cnt = 0;
+  bool use_large = !no_large_pages && cpu_has_pse ();
   extern char _start, _end_kernel_text;
 
+  if (use_large) 
+    {
+      /* Enable 4 MB pages.  See [IA32-v3a] 2.5 "Control
+         Registers". */
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++)
@@ -173,12 +217,25 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
+          char *region_end = vaddr + PTSPAN;
+          if (use_large && pte_idx == 0
+              && page + PTSPAN / PGSIZE <= init_ram_pages
+              && (region_end <= &_start || vaddr >= &_end_kernel_text)) 
+            {
+              pd[pde_idx] = pde_create_large (vaddr, true);
+              page += PTSPAN / PGSIZE - 1;
+              large_cnt++;
+              continue;
+            }
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
+          pt_cnt++;
         }
 
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
+  printf ("Kernel memory mapped with %zu 4 MB pages and %zu page tables.\n",
+          large_cnt, pt_cnt);
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -188,6 +245,17 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages.
+   See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -250,12 +318,24 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-faultaround"))
+        page_fault_around = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-profile"))
+        profile_enabled = true;
+      else if (!strcmp (name, "-nopse"))
+        no_large_pages = true;
+      else if (!strcmp (name, "-lowat"))
+        palloc_low_watermark = atoi (value);
+      else if (!strcmp (name, "-hiwat"))
+        palloc_high_watermark = atoi (value);
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -292,6 +372,13 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints the call sites and threads holding the most memory. */
+static void
+run_memstat (char **argv UNUSED) 
+{
+  memtrack_print_stats ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,6 +396,7 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"memstat", 1, run_memstat},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -357,6 +445,7 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  memstat            Print top memory users (needs MEM_TRACK=1).\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -375,10 +464,16 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -faultaround=N     Map up to N file pages per page fault.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the periodic timer while idle.\n"
+          "  -profile           Sample the running code at each timer tick.\n"
+          "  -nopse             Map kernel memory with 4 kB pages only.\n"
+          "  -lowat=COUNT       Grow a pool when under COUNT pages are free.\n"
+          "  -hiwat=COUNT       Keep COUNT pages free when lending.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -5,17 +5,23 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   The size of each request, in bytes, is rounded up to a "size
+   class" and assigned to the "descriptor" that manages blocks of
+   that size.  The size classes are the powers of 2 from 16 to
+   1024 and the sizes halfway between them (24, 48, 96, ...), so
+   that rounding wastes at most a third of a block instead of
+   half.  A table indexed by the request size in units of
+   SIZE_STEP bytes maps each request to its descriptor directly.
+   The descriptor keeps a list of free blocks.  If the free list
+   is nonempty, one of its blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -32,7 +38,36 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   realloc() returns the same block when the new size still fits
+   in it.  A big block that must grow is extended in place if the
+   pages that follow it are free, and one that shrinks gives its
+   excess pages back.
+
+   In front of each descriptor's free list sits a "magazine", a
+   small stack of free blocks that malloc() and free() can use
+   with interrupts briefly disabled instead of taking the
+   descriptor's lock.  The magazine belongs to the CPU, not to
+   any thread, so there is just one per descriptor, and no thread
+   can strand blocks in it by exiting.  When the magazine is
+   empty, malloc() takes the lock and moves up to MAG_BATCH blocks
+   from the free list into it; when it is full, free() takes the
+   lock and moves MAG_BATCH blocks back.  Blocks in a magazine
+   count as in use for the purpose of releasing arenas. */
+
+/* Granularity of the size-to-descriptor table, in bytes. */
+#define SIZE_STEP 8
+
+/* Largest block size handled by a descriptor. */
+#define MAX_BLOCK_SIZE 1024
+
+/* Capacity of a magazine, in blocks. */
+#define MAG_SIZE 16
+
+/* Number of blocks moved between a magazine and its descriptor's
+   free list at a time. */
+#define MAG_BATCH 8
 
 /* Descriptor. */
 struct desc
@@ -41,6 +76,17 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+
+    /* Magazine.  Protected by disabling interrupts. */
+    struct block *magazine[MAG_SIZE]; /* Free blocks. */
+    size_t mag_cnt;             /* Number of blocks in magazine. */
+
+    /* Statistics. */
+    unsigned hit_cnt;           /* Allocations from the magazine. */
+    unsigned refill_cnt;        /* Refills of the magazine. */
+    unsigned drain_cnt;         /* Drains of the magazine. */
+    unsigned arena_cnt;         /* Arenas created. */
+    unsigned release_cnt;       /* Arenas given back. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -61,19 +107,52 @@ struct block
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[16];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Maps a request of N bytes, for 0 < N <= MAX_BLOCK_SIZE, to
+   the descriptor at index size_desc[DIV_ROUND_UP (N, SIZE_STEP)]
+   in descs[]. */
+static uint8_t size_desc[MAX_BLOCK_SIZE / SIZE_STEP + 1];
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *take_block (struct desc *);
+static void put_block (struct desc *, struct block *);
+static bool resize_in_place (void *, size_t new_size);
+
+#ifdef MEM_TRACK
+/* With MEM_TRACK, the allocation functions below are defined
+   under these names instead, and the wrappers at the end of this
+   file report each call to memtrack.  calloc() and realloc() call
+   the untracked malloc() and free(), and arenas come from the
+   untracked page allocator, so that each block is charged to the
+   original caller only once. */
+#define palloc_get_multiple palloc_get_multiple_untracked
+#define palloc_get_page palloc_get_page_untracked
+#define palloc_free_multiple palloc_free_multiple_untracked
+#define palloc_free_page palloc_free_page_untracked
+#define malloc malloc_untracked
+#define calloc calloc_untracked
+#define realloc realloc_untracked
+#define free free_untracked
+static void *malloc_untracked (size_t);
+static void *calloc_untracked (size_t, size_t);
+static void *realloc_untracked (void *, size_t);
+static void free_untracked (void *);
+#endif
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
-  size_t block_size;
+  size_t block_size, i, j;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  /* Create descriptors for the size classes, alternately
+     multiplying the block size by 3/2 and by 4/3. */
+  for (block_size = 16; block_size <= MAX_BLOCK_SIZE;
+       block_size = block_size % 3 == 0 ? block_size / 3 * 4
+                                        : block_size / 2 * 3)
     {
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
@@ -81,6 +160,15 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      d->mag_cnt = 0;
+    }
+
+  /* Fill in the size-to-descriptor table. */
+  for (i = j = 0; i < sizeof size_desc / sizeof *size_desc; i++) 
+    {
+      while (descs[j].block_size < i * SIZE_STEP)
+        j++;
+      size_desc[i] = j;
     }
 }
 
@@ -92,6 +180,7 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -99,10 +188,7 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  if (size > MAX_BLOCK_SIZE) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
@@ -118,6 +204,18 @@ malloc (size_t size)
       a->free_cnt = page_cnt;
       return a + 1;
     }
+  d = &descs[size_desc[DIV_ROUND_UP (size, SIZE_STEP)]];
+
+  /* Try the magazine first. */
+  old_level = intr_disable ();
+  if (d->mag_cnt > 0) 
+    {
+      b = d->magazine[--d->mag_cnt];
+      d->hit_cnt++;
+      intr_set_level (old_level);
+      return b;
+    }
+  intr_set_level (old_level);
 
   lock_acquire (&d->lock);
 
@@ -143,12 +241,18 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      d->arena_cnt++;
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* Get a block from free list to return, and refill the
+     magazine with up to MAG_BATCH - 1 more. */
+  b = take_block (d);
+  old_level = intr_disable ();
+  while (d->mag_cnt < MAG_BATCH - 1 && !list_empty (&d->free_list))
+    d->magazine[d->mag_cnt++] = take_block (d);
+  d->refill_cnt++;
+  intr_set_level (old_level);
+
   lock_release (&d->lock);
   return b;
 }
@@ -174,9 +278,11 @@ calloc (size_t a, size_t b)
   return p;
 }
 
-/* Returns the number of bytes allocated for BLOCK. */
-static size_t
-block_size (void *block) 
+/* Returns the number of bytes allocated for BLOCK, which must
+   have been obtained from malloc(), calloc(), or realloc().  This
+   may be more than the size requested. */
+size_t
+malloc_usable_size (void *block) 
 {
   struct block *b = block;
   struct arena *a = block_to_arena (b);
@@ -199,12 +305,14 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    return old_block;
   else 
     {
       void *new_block = malloc (new_size);
       if (old_block != NULL && new_block != NULL)
         {
-          size_t old_size = block_size (old_block);
+          size_t old_size = malloc_usable_size (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
           free (old_block);
@@ -213,6 +321,30 @@ realloc (void *old_block, size_t new_size)
     }
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   Returns true if successful, false if BLOCK must move. */
+static bool
+resize_in_place (void *block, size_t new_size) 
+{
+  struct arena *a = block_to_arena (block);
+  size_t page_cnt;
+
+  /* A normal block can only stay put if it is big enough. */
+  if (a->desc != NULL)
+    return new_size <= a->desc->block_size;
+
+  /* A big block can give back pages it no longer needs, or take
+     the pages that follow it if they are free. */
+  page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  if (page_cnt <= a->free_cnt)
+    palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+                          a->free_cnt - page_cnt);
+  else if (!palloc_extend (a, a->free_cnt, page_cnt))
+    return false;
+  a->free_cnt = page_cnt;
+  return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
@@ -227,31 +359,38 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct block *batch[MAG_BATCH];
+          enum intr_level old_level;
+          size_t i, batch_cnt;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put the block in the magazine, if it has room. */
+          old_level = intr_disable ();
+          if (d->mag_cnt < MAG_SIZE) 
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              d->magazine[d->mag_cnt++] = b;
+              intr_set_level (old_level);
+              return;
             }
+          intr_set_level (old_level);
 
+          /* Otherwise, drain MAG_BATCH blocks from the magazine and
+             return them to the free list along with the block. */
+          lock_acquire (&d->lock);
+          old_level = intr_disable ();
+          for (batch_cnt = 0; batch_cnt < MAG_BATCH && d->mag_cnt > 0;
+               batch_cnt++)
+            batch[batch_cnt] = d->magazine[--d->mag_cnt];
+          d->drain_cnt++;
+          intr_set_level (old_level);
+
+          for (i = 0; i < batch_cnt; i++)
+            put_block (d, batch[i]);
+          put_block (d, b);
           lock_release (&d->lock);
         }
       else
@@ -263,6 +402,64 @@ free (void *p)
     }
 }
 
+/* Removes a block from D's free list, which must not be empty,
+   and returns it.  D's lock must be held. */
+static struct block *
+take_block (struct desc *d) 
+{
+  struct block *b;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  block_to_arena (b)->free_cnt--;
+  return b;
+}
+
+/* Adds block B to D's free list.  If B's arena is now entirely
+   unused, frees the arena.  D's lock must be held. */
+static void
+put_block (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+      d->release_cnt++;
+    }
+}
+
+/* Prints statistics for each malloc() descriptor that has been
+   used. */
+void
+malloc_print_stats (void) 
+{
+  struct desc *d;
+
+  printf ("Malloc: %6s %10s %8s %8s %8s %8s\n",
+          "size", "hits", "refills", "drains", "arenas", "released");
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->refill_cnt > 0)
+      printf ("Malloc: %6zu %10u %8u %8u %8u %8u\n",
+              d->block_size, d->hit_cnt, d->refill_cnt, d->drain_cnt,
+              d->arena_cnt, d->release_cnt);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -292,3 +489,48 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+#ifdef MEM_TRACK
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+/* Tracked version of malloc(). */
+void *
+malloc (size_t size) 
+{
+  void *p = malloc_untracked (size);
+  memtrack_alloc (p, size, __builtin_return_address (0));
+  return p;
+}
+
+/* Tracked version of calloc(). */
+void *
+calloc (size_t a, size_t b) 
+{
+  void *p = calloc_untracked (a, b);
+  memtrack_alloc (p, a * b, __builtin_return_address (0));
+  return p;
+}
+
+/* Tracked version of realloc().  A resized block, even one that
+   did not move, is charged to the caller of realloc(). */
+void *
+realloc (void *old_block, size_t new_size) 
+{
+  void *new_block = realloc_untracked (old_block, new_size);
+  if (new_block != NULL || new_size == 0)
+    memtrack_free (old_block);
+  memtrack_alloc (new_block, new_size, __builtin_return_address (0));
+  return new_block;
+}
+
+/* Tracked version of free(). */
+void
+free (void *p) 
+{
+  memtrack_free (p);
+  free_untracked (p);
+}
+#endif /* MEM_TRACK */
@@ -0,0 +1,281 @@
+#include "threads/memtrack.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Live allocations are kept in one open-addressed hash table,
+   keyed by address, and statistics for each call site in
+   another, keyed by return address.  Both use linear probing and
+   live in pages obtained at startup, so that tracking never
+   allocates memory itself.  The tables are protected by
+   disabling interrupts, as palloc's pools are.
+
+   If either table fills up, further allocations go untracked,
+   and the number of them is reported. */
+
+/* Number of slots in the tables.  Must be powers of 2. */
+#define ALLOC_SLOTS 8192
+#define SITE_SLOTS 1024
+
+/* Number of call sites and threads printed. */
+#define TOP_CNT 10
+
+/* A live allocation. */
+struct mem_alloc 
+  {
+    void *addr;                 /* Address, or null if slot unused. */
+    struct mem_site *site;      /* Allocating call site. */
+    size_t size;                /* Size in bytes. */
+    tid_t tid;                  /* Allocating thread. */
+  };
+
+/* Statistics for a call site. */
+struct mem_site 
+  {
+    const void *caller;         /* Return address, or null if unused. */
+    size_t live_bytes;          /* Bytes allocated and not freed. */
+    size_t peak_bytes;          /* Maximum of live_bytes. */
+    unsigned alloc_cnt;         /* Number of allocations. */
+    unsigned free_cnt;          /* Number of frees. */
+  };
+
+/* Memory held by a thread, for memtrack_print_stats(). */
+struct mem_owner 
+  {
+    tid_t tid;                  /* Thread. */
+    size_t live_bytes;          /* Bytes allocated and not freed. */
+  };
+
+static struct mem_alloc *allocs;        /* Live allocations. */
+static struct mem_site *sites;          /* Call sites. */
+static unsigned untracked_cnt;          /* Allocations not tracked. */
+
+static size_t hash_ptr (const void *, size_t slot_cnt);
+static struct mem_alloc *find_alloc (const void *addr);
+static struct mem_site *find_site (const void *caller);
+static void remove_alloc (struct mem_alloc *);
+
+/* Allocates the tracking tables.  Allocations made before this
+   is called are not tracked. */
+void
+memtrack_init (void) 
+{
+  size_t alloc_bytes = ALLOC_SLOTS * sizeof *allocs;
+  size_t site_bytes = SITE_SLOTS * sizeof *sites;
+  uint8_t *tables;
+
+  tables = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                DIV_ROUND_UP (alloc_bytes + site_bytes,
+                                              PGSIZE));
+  sites = (struct mem_site *) (tables + alloc_bytes);
+  allocs = (struct mem_alloc *) tables;
+}
+
+/* Records that SIZE bytes at P were allocated by the call that
+   returns to CALLER.  Does nothing if P is null. */
+void
+memtrack_alloc (void *p, size_t size, const void *caller) 
+{
+  enum intr_level old_level;
+  struct mem_alloc *a;
+  struct mem_site *s;
+
+  if (p == NULL || allocs == NULL)
+    return;
+
+  old_level = intr_disable ();
+  a = find_alloc (p);
+  s = find_site (caller);
+  if (a != NULL && a->addr == NULL && s != NULL) 
+    {
+      a->addr = p;
+      a->site = s;
+      a->size = size;
+      a->tid = thread_current ()->tid;
+
+      s->caller = caller;
+      s->alloc_cnt++;
+      s->live_bytes += size;
+      if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+    }
+  else
+    untracked_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Records that the allocation at P was freed.  Does nothing if P
+   is null or was not tracked. */
+void
+memtrack_free (void *p) 
+{
+  enum intr_level old_level;
+  struct mem_alloc *a;
+
+  if (p == NULL || allocs == NULL)
+    return;
+
+  old_level = intr_disable ();
+  a = find_alloc (p);
+  if (a != NULL && a->addr == p) 
+    {
+      a->site->live_bytes -= a->size;
+      a->site->free_cnt++;
+      remove_alloc (a);
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints the call sites and threads holding the most memory. */
+void
+memtrack_print_stats (void) 
+{
+  struct mem_site *top[TOP_CNT];
+  struct mem_owner owners[TOP_CNT + 1];
+  enum intr_level old_level;
+  size_t top_cnt = 0, owner_cnt = 0;
+  size_t i, j;
+
+  if (allocs == NULL) 
+    {
+      printf ("Memory: tracking disabled (build with MEM_TRACK=1)\n");
+      return;
+    }
+
+  old_level = intr_disable ();
+
+  /* Find the TOP_CNT sites with the most live bytes, by
+     insertion into a sorted array. */
+  for (i = 0; i < SITE_SLOTS; i++) 
+    {
+      struct mem_site *s = &sites[i];
+      if (s->caller == NULL)
+        continue;
+      for (j = top_cnt; j > 0 && top[j - 1]->live_bytes < s->live_bytes; j--)
+        if (j < TOP_CNT)
+          top[j] = top[j - 1];
+      if (j < TOP_CNT) 
+        {
+          top[j] = s;
+          if (top_cnt < TOP_CNT)
+            top_cnt++;
+        }
+    }
+
+  /* Total live bytes by thread.  Threads beyond the first
+     TOP_CNT seen are lumped together under TID_ERROR. */
+  owners[TOP_CNT].tid = TID_ERROR;
+  owners[TOP_CNT].live_bytes = 0;
+  for (i = 0; i < ALLOC_SLOTS; i++) 
+    {
+      struct mem_alloc *a = &allocs[i];
+      if (a->addr == NULL)
+        continue;
+      for (j = 0; j < owner_cnt && owners[j].tid != a->tid; j++)
+        continue;
+      if (j == owner_cnt && owner_cnt < TOP_CNT) 
+        {
+          owners[j].tid = a->tid;
+          owners[j].live_bytes = 0;
+          owner_cnt++;
+        }
+      owners[j < owner_cnt ? j : TOP_CNT].live_bytes += a->size;
+    }
+
+  printf ("Memory: %10s %10s %10s %8s %8s\n",
+          "caller", "live", "peak", "allocs", "frees");
+  for (i = 0; i < top_cnt; i++)
+    printf ("Memory: %10p %10zu %10zu %8u %8u\n",
+            top[i]->caller, top[i]->live_bytes, top[i]->peak_bytes,
+            top[i]->alloc_cnt, top[i]->free_cnt);
+  for (i = 0; i < owner_cnt; i++)
+    printf ("Memory: thread %d holds %zu bytes\n",
+            owners[i].tid, owners[i].live_bytes);
+  if (owners[TOP_CNT].live_bytes > 0)
+    printf ("Memory: other threads hold %zu bytes\n",
+            owners[TOP_CNT].live_bytes);
+  if (untracked_cnt > 0)
+    printf ("Memory: %u allocations not tracked (tables full)\n",
+            untracked_cnt);
+
+  intr_set_level (old_level);
+}
+
+/* Returns a hash of P for a table of SLOT_CNT slots. */
+static size_t
+hash_ptr (const void *p, size_t slot_cnt) 
+{
+  /* Fibonacci hashing.  See [Knuth] 6.4. */
+  return ((uintptr_t) p * 2654435761u) >> 16 & (slot_cnt - 1);
+}
+
+/* Returns the slot in allocs[] that holds ADDR, or the empty
+   slot where it would be added, or a null pointer if ADDR is
+   not in the table and the table is full. */
+static struct mem_alloc *
+find_alloc (const void *addr) 
+{
+  size_t i = hash_ptr (addr, ALLOC_SLOTS);
+  size_t probe_cnt;
+
+  for (probe_cnt = 0; probe_cnt < ALLOC_SLOTS; probe_cnt++) 
+    {
+      struct mem_alloc *a = &allocs[i];
+      if (a->addr == addr || a->addr == NULL)
+        return a;
+      i = (i + 1) & (ALLOC_SLOTS - 1);
+    }
+  return NULL;
+}
+
+/* Returns the slot in sites[] for CALLER, or the empty slot
+   where it would be added, or a null pointer if CALLER is not in
+   the table and the table is full. */
+static struct mem_site *
+find_site (const void *caller) 
+{
+  size_t i = hash_ptr (caller, SITE_SLOTS);
+  size_t probe_cnt;
+
+  for (probe_cnt = 0; probe_cnt < SITE_SLOTS; probe_cnt++) 
+    {
+      struct mem_site *s = &sites[i];
+      if (s->caller == caller || s->caller == NULL)
+        return s;
+      i = (i + 1) & (SITE_SLOTS - 1);
+    }
+  return NULL;
+}
+
+/* Removes A from allocs[].  Moves back any later entries in the
+   same run of occupied slots that would otherwise become
+   unreachable.  See [Knuth] 6.4 Algorithm R. */
+static void
+remove_alloc (struct mem_alloc *a) 
+{
+  size_t i = a - allocs;
+  size_t j = i;
+
+  for (;;) 
+    {
+      size_t k;
+
+      allocs[i].addr = NULL;
+      do 
+        {
+          j = (j + 1) & (ALLOC_SLOTS - 1);
+          if (allocs[j].addr == NULL)
+            return;
+          k = hash_ptr (allocs[j].addr, ALLOC_SLOTS);
+        }
+      while (i <= j ? i < k && k <= j : i < k || k <= j);
+      allocs[i] = allocs[j];
+      i = j;
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef THREADS_MEMTRACK_H
+#define THREADS_MEMTRACK_H
+
+#include <stddef.h>
+
+/* Kernel memory accounting.
+
+   In a kernel built with "make MEM_TRACK=1", palloc, malloc, and
+   the slab allocator report each allocation to memtrack_alloc(),
+   tagged with the return address of the allocating call, and
+   each free to memtrack_free().  memtrack_print_stats() then
+   shows which call sites and threads hold the most memory.
+   Otherwise, none of these functions is called, so tracking
+   costs nothing. */
+
+void memtrack_init (void);
+void memtrack_alloc (void *, size_t size, const void *caller);
+void memtrack_free (void *);
+void memtrack_print_stats (void);
+
+#endif /* threads/memtrack.h */
@@ -2,13 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/memtrack.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -21,24 +23,128 @@
    that the kernel needs to have memory for its own operations
    even if user processes are swapping like mad.
 
-   By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   Initially, half of system RAM is given to the kernel pool and
+   half to the user pool.  The split then shifts with demand: a
+   pool whose free pages drop below palloc_low_watermark, or that
+   cannot satisfy a request, takes a free, aligned "chunk" of
+   CHUNK_PAGES pages from the other pool, as long as the other
+   pool keeps at least palloc_high_watermark pages free.  A pool
+   that runs low takes back chunks it lent in the same way.  The
+   kernel pool looks for chunks starting at the lowest address
+   and the user pool starting at the highest, where each began,
+   so each reclaims its own chunks first.  The user pool never
+   grows beyond the limit passed to palloc_init().
+
+   To make chunks easy to move, both pools index all of free
+   memory from a common base.  Each pool marks the pages that it
+   does not own as in use in its own used_map, and the user_owned
+   bitmap records which pool owns each page.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept in blocks of 2**ORDER pages, for ORDER from 0 up to
+   MAX_ORDER - 1, each aligned on a multiple of its own size
+   relative to the pool's base, on one free list per order.  A
+   request for N pages takes a block of the smallest order that
+   fits, splitting larger blocks in half as needed, and returns
+   the pages beyond N to the free lists.  Freeing pages merges
+   each block with its "buddy", the other half of the block it
+   was split from, whenever the buddy is free too.  Both take
+   O(MAX_ORDER) time.  An allocation can also be grown in place,
+   if the pages after it are free, by carving those pages out of
+   whatever free blocks hold them.
+
+   The free lists are threaded through the free pages themselves.
+   The pools are protected by disabling interrupts, not by a
+   lock, because the scheduler frees the pages of dying threads
+   with interrupts off.
+
+   Each pool also keeps a small stash of pages that the idle
+   thread has already filled with zeros, so that single-page
+   PAL_ZERO requests, such as for thread stacks and page tables,
+   need not zero their page on the spot.  Stashed pages count as
+   allocated.  If a request cannot otherwise be satisfied, the
+   stash is given back to the free lists first. */
+
+/* Number of block orders. */
+#define MAX_ORDER 20
+
+/* Maximum number of pages in a pool's stash of zeroed pages. */
+#define ZERO_STASH_PAGES 32
+
+/* Maximum number of pages zeroed by each palloc_zero_idle(). */
+#define IDLE_ZERO_PAGES 4
+
+/* Number of pages in a chunk lent between pools (1 MB). */
+#define CHUNK_PAGES 256
+
+/* Free page counts that trigger borrowing a chunk (low) and that
+   a pool must keep when lending one (high).  Set by the -lowat
+   and -hiwat kernel command-line options. */
+size_t palloc_low_watermark = 32;
+size_t palloc_high_watermark = 128;
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages. */
+    int8_t *free_order;                 /* Per page: order of free
+                                           block it begins, or -1. */
+    struct list free_lists[MAX_ORDER];  /* Free blocks, by order. */
+    size_t free_cnt;                    /* Pages in free_lists. */
+    size_t owned_cnt;                   /* Pages owned by the pool. */
+
+    /* Statistics. */
+    size_t min_free_cnt;                /* Lowest free_cnt seen. */
+    unsigned borrow_cnt;                /* Chunks taken from the
+                                           other pool. */
+    unsigned lend_cnt;                  /* Chunks given to the
+                                           other pool. */
+    unsigned fail_cnt;                  /* Failed allocations. */
+
+    struct list zeroed;                 /* Stash of zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in stash. */
+    unsigned zero_hit_cnt;              /* PAL_ZERO pages from stash. */
+    unsigned zero_miss_cnt;             /* PAL_ZERO pages zeroed
+                                           on demand. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
-static void init_pool (struct pool *, void *base, size_t page_cnt,
+/* Pages owned by the user pool, indexed from the pools' base. */
+static struct bitmap *user_owned;
+
+/* Maximum number of pages in the user pool. */
+static size_t user_pool_limit;
+
+static void init_pool (struct pool *, uint8_t **meta, uint8_t *base,
+                       size_t page_cnt, size_t first_idx, size_t own_cnt,
                        const char *name);
+static bool may_borrow (const struct pool *, size_t page_cnt);
+static bool borrow_chunk (struct pool *);
+static void return_chunks (struct pool *, size_t chunk_cnt);
+static bool move_chunk (struct pool *from, struct pool *to);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *page_pool (void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_claim (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static bool zero_page (struct pool *);
+static void release_zeroed (struct pool *);
+static void print_pool_stats (const struct pool *, const char *name);
+
+#ifdef MEM_TRACK
+/* With MEM_TRACK, the allocation functions below are defined
+   under these names instead, and the wrappers at the end of this
+   file report each call to memtrack before or after calling
+   them. */
+#define palloc_get_multiple palloc_get_multiple_untracked
+#define palloc_get_page palloc_get_page_untracked
+#define palloc_free_multiple palloc_free_multiple_untracked
+#define palloc_free_page palloc_free_page_untracked
+#endif
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -49,15 +155,34 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
+  size_t bm_size = bitmap_buf_size (free_pages);
+  size_t meta_pages, page_cnt, user_pages, kernel_pages;
+  uint8_t *meta = free_start;
+
+  /* We'll put user_owned and each pool's used_map and free_order
+     at the start of free memory.  Calculate the space needed for
+     them and subtract it from the pages to manage. */
+  meta_pages = DIV_ROUND_UP (3 * bm_size + 2 * free_pages, PGSIZE);
+  if (meta_pages >= free_pages)
+    PANIC ("Not enough memory for page allocator bitmaps.");
+  page_cnt = free_pages - meta_pages;
+
+  /* Give half of memory to kernel, half to user. */
+  user_pages = page_cnt / 2;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
-  kernel_pages = free_pages - user_pages;
+  kernel_pages = page_cnt - user_pages;
+  user_pool_limit = user_page_limit;
+  if (palloc_high_watermark < palloc_low_watermark)
+    palloc_high_watermark = palloc_low_watermark;
 
-  /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
+  user_owned = bitmap_create_in_buf (page_cnt, meta, bm_size);
+  bitmap_set_multiple (user_owned, kernel_pages, user_pages, true);
+  meta += bm_size;
+  free_start += meta_pages * PGSIZE;
+  init_pool (&kernel_pool, &meta, free_start, page_cnt, 0, kernel_pages,
+             "kernel pool");
+  init_pool (&user_pool, &meta, free_start, page_cnt, kernel_pages,
              user_pages, "user pool");
 }
 
@@ -71,15 +196,64 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+
+  /* Serve a single zeroed page from the stash, if possible.  Only
+     the list element that linked it into the stash needs to be
+     cleared. */
+  if ((flags & PAL_ZERO) && page_cnt == 1 && !list_empty (&pool->zeroed)) 
+    {
+      pages = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+      pool->zero_hit_cnt++;
+      intr_set_level (old_level);
+      memset (pages, 0, sizeof (struct list_elem));
+      return pages;
+    }
+
+  page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0) 
+    {
+      release_zeroed (pool);
+      page_idx = buddy_alloc (pool, page_cnt);
+    }
+  if (page_idx == BITMAP_ERROR && may_borrow (pool, page_cnt)) 
+    {
+      /* Borrow no more chunks than the request could use, and
+         give them back if they did not help. */
+      size_t borrow_max = DIV_ROUND_UP (page_cnt, CHUNK_PAGES);
+      size_t borrowed = 0;
+      while (page_idx == BITMAP_ERROR && borrowed < borrow_max
+             && borrow_chunk (pool)) 
+        {
+          borrowed++;
+          page_idx = buddy_alloc (pool, page_cnt);
+        }
+      if (page_idx == BITMAP_ERROR)
+        return_chunks (pool, borrowed);
+    }
+  if (page_idx != BITMAP_ERROR) 
+    {
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+      if (flags & PAL_ZERO)
+        pool->zero_miss_cnt++;
+
+      /* Borrow ahead of need if the pool is running low. */
+      if (pool->free_cnt < pool->min_free_cnt)
+        pool->min_free_cnt = pool->free_cnt;
+      if (pool->free_cnt < palloc_low_watermark)
+        borrow_chunk (pool);
+    }
+  else
+    pool->fail_cnt++;
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -113,32 +287,64 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
+/* Tries to grow the group of PAGE_CNT pages starting at PAGES,
+   which must have been obtained from palloc_get_multiple(), to
+   NEW_CNT pages without moving it, by taking the pages that
+   follow it.  Returns true if successful.  Returns false, leaving
+   the group unchanged, if any of those pages is in use or lies
+   beyond the end of the pool.  The new pages are not zeroed. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt) 
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t page_idx;
+  bool success;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (page_cnt > 0);
+  ASSERT (new_cnt >= page_cnt);
+
+  pool = page_pool (pages);
+  page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+  page_cnt = new_cnt - page_cnt;
+
+  old_level = intr_disable ();
+  success = (page_idx + page_cnt <= pool->page_cnt
+             && bitmap_none (pool->used_map, page_idx, page_cnt));
+  if (success) 
+    {
+      buddy_claim (pool, page_idx, page_cnt);
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = page_pool (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +354,75 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END,
-   naming it NAME for debugging purposes. */
+/* Zeroes up to IDLE_ZERO_PAGES free pages and adds them to the
+   pools' stashes of zeroed pages, filling the kernel pool's stash
+   first.  Called by the idle thread with interrupts on, so that
+   the zeroing takes otherwise idle time. */
+void
+palloc_zero_idle (void) 
+{
+  int i;
+
+  for (i = 0; i < IDLE_ZERO_PAGES; i++)
+    if (!zero_page (&kernel_pool) && !zero_page (&user_pool))
+      break;
+}
+
+/* Prints statistics on the stashes of zeroed pages. */
+void
+palloc_print_stats (void) 
+{
+  print_pool_stats (&kernel_pool, "kernel");
+  print_pool_stats (&user_pool, "user");
+}
+
+/* Prints usage statistics for POOL, named NAME. */
 static void
-init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
+print_pool_stats (const struct pool *pool, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  printf ("Palloc: %s pool: %zu pages, %zu free (min %zu), "
+          "%u chunks borrowed, %u lent, %u failures\n",
+          name, pool->owned_cnt, pool->free_cnt, pool->min_free_cnt,
+          pool->borrow_cnt, pool->lend_cnt, pool->fail_cnt);
+  printf ("Palloc: %s pool: %u zeroed pages from stash, "
+          "%u zeroed on demand, %zu stashed\n",
+          name, pool->zero_hit_cnt, pool->zero_miss_cnt, pool->zeroed_cnt);
+}
 
-  printf ("%zu pages available in %s.\n", page_cnt, name);
+/* Initializes pool P to manage PAGE_CNT pages starting at BASE,
+   of which it owns OWN_CNT pages starting at index FIRST_IDX.
+   Allocates P's used_map and free_order from *META, advancing
+   it.  Names the pool NAME for debugging purposes. */
+static void
+init_pool (struct pool *p, uint8_t **meta, uint8_t *base, size_t page_cnt,
+           size_t first_idx, size_t own_cnt, const char *name) 
+{
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  int order;
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  printf ("%zu pages available in %s.\n", own_cnt, name);
+
+  /* Initialize the pool, with all pages in use. */
+  p->used_map = bitmap_create_in_buf (page_cnt, *meta, bm_size);
+  bitmap_set_all (p->used_map, true);
+  p->free_order = (int8_t *) *meta + bm_size;
+  memset (p->free_order, -1, page_cnt);
+  *meta += bm_size + page_cnt;
+  p->base = base;
+  p->page_cnt = page_cnt;
+  for (order = 0; order < MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
+  p->free_cnt = 0;
+  p->owned_cnt = own_cnt;
+  p->borrow_cnt = p->lend_cnt = p->fail_cnt = 0;
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zero_hit_cnt = p->zero_miss_cnt = 0;
+
+  /* Free the pages that the pool owns. */
+  bitmap_set_multiple (p->used_map, first_idx, own_cnt, false);
+  buddy_free (p, first_idx, own_cnt);
+  p->min_free_cnt = p->free_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +432,356 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
+
+  if (page_no < start_page || page_no >= end_page)
+    return false;
+  return bitmap_test (user_owned, page_no - start_page)
+         == (pool == &user_pool);
+}
+
+/* Returns true if borrowing from the other pool could let POOL
+   satisfy a request for PAGE_CNT pages, that is, if POOL's free
+   pages plus those the other pool can spare above its high
+   watermark add up to PAGE_CNT.  Otherwise, borrowing would only
+   move memory that the request still could not use. */
+static bool
+may_borrow (const struct pool *pool, size_t page_cnt) 
+{
+  const struct pool *lender = pool == &user_pool ? &kernel_pool : &user_pool;
+  size_t spare_cnt = (lender->free_cnt > palloc_high_watermark
+                      ? lender->free_cnt - palloc_high_watermark : 0);
+
+  return pool->free_cnt + spare_cnt >= page_cnt;
+}
+
+/* Moves a free chunk of CHUNK_PAGES pages from the other pool to
+   POOL, if the other pool can spare one and POOL may grow.
+   Returns true if successful, false otherwise. */
+static bool
+borrow_chunk (struct pool *pool) 
+{
+  struct pool *lender = pool == &user_pool ? &kernel_pool : &user_pool;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (lender->free_cnt < CHUNK_PAGES + palloc_high_watermark
+      || (pool == &user_pool
+          && pool->owned_cnt + CHUNK_PAGES > user_pool_limit)
+      || !move_chunk (lender, pool))
+    return false;
+
+  lender->lend_cnt++;
+  pool->borrow_cnt++;
+  return true;
+}
+
+/* Gives CHUNK_CNT chunks that POOL just borrowed, and that are
+   still free, back to the other pool. */
+static void
+return_chunks (struct pool *pool, size_t chunk_cnt) 
+{
+  struct pool *lender = pool == &user_pool ? &kernel_pool : &user_pool;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (chunk_cnt-- > 0 && move_chunk (pool, lender)) 
+    {
+      lender->lend_cnt--;
+      pool->borrow_cnt--;
+    }
+}
+
+/* Moves a chunk that FROM owns and has entirely free to TO.  The
+   kernel pool takes chunks from the bottom of memory and the user
+   pool from the top.  Returns true if successful, false if FROM
+   has no free chunk. */
+static bool
+move_chunk (struct pool *from, struct pool *to) 
+{
+  bool to_user = to == &user_pool;
+  size_t chunk_cnt = to->page_cnt / CHUNK_PAGES;
+  size_t i;
+
+  for (i = 0; i < chunk_cnt; i++) 
+    {
+      size_t chunk = to_user ? chunk_cnt - 1 - i : i;
+      size_t page_idx = chunk * CHUNK_PAGES;
+
+      /* Pages owned by TO are in use in FROM's used_map, so this
+         finds only chunks that FROM owns and has free. */
+      if (bitmap_none (from->used_map, page_idx, CHUNK_PAGES)) 
+        {
+          buddy_claim (from, page_idx, CHUNK_PAGES);
+          bitmap_set_multiple (from->used_map, page_idx, CHUNK_PAGES, true);
+          from->owned_cnt -= CHUNK_PAGES;
+
+          bitmap_set_multiple (user_owned, page_idx, CHUNK_PAGES, to_user);
+
+          bitmap_set_multiple (to->used_map, page_idx, CHUNK_PAGES, false);
+          buddy_free (to, page_idx, CHUNK_PAGES);
+          to->owned_cnt += CHUNK_PAGES;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Returns the pool that PAGE was allocated from. */
+static struct pool *
+page_pool (void *page) 
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
+}
+
+/* Returns the index of the least significant set bit in X, which
+   must be nonzero.  See [IA32-v2a] "BSF--Bit Scan Forward". */
+static inline int
+bsf (uint32_t x) 
+{
+  int idx;
+  asm ("bsfl %1, %0" : "=r" (idx) : "rm" (x));
+  return idx;
+}
+
+/* Returns the index of the most significant set bit in X, which
+   must be nonzero.  See [IA32-v2a] "BSR--Bit Scan Reverse". */
+static inline int
+bsr (uint32_t x) 
+{
+  int idx;
+  asm ("bsrl %1, %0" : "=r" (idx) : "rm" (x));
+  return idx;
+}
+
+/* Returns the free list element stored in page PAGE_IDX of
+   POOL. */
+static struct list_elem *
+page_elem (struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + page_idx * PGSIZE);
+}
+
+/* Removes the free block of order ORDER at PAGE_IDX in POOL from
+   its free list. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order) 
+{
+  ASSERT (pool->free_order[page_idx] == order);
+
+  list_remove (page_elem (pool, page_idx));
+  pool->free_order[page_idx] = -1;
+  pool->free_cnt -= (size_t) 1 << order;
+}
+
+/* Adds the block of order ORDER at PAGE_IDX in POOL to its free
+   list, merging it with its buddy, and the resulting block with
+   its own buddy, and so on, as long as the buddy is free. */
+static void
+insert_block (struct pool *pool, size_t page_idx, int order) 
+{
+  while (order < MAX_ORDER - 1) 
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx >= pool->page_cnt
+          || pool->free_order[buddy_idx] != order)
+        break;
+      remove_block (pool, buddy_idx, order);
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+
+  list_push_front (&pool->free_lists[order], page_elem (pool, page_idx));
+  pool->free_order[page_idx] = order;
+  pool->free_cnt += (size_t) 1 << order;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if POOL has no free
+   block large enough. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) 
+{
+  int want_order = page_cnt > 1 ? bsr (page_cnt - 1) + 1 : 0;
+  int order;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Find the smallest free block that fits. */
+  for (order = want_order; order < MAX_ORDER; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order >= MAX_ORDER)
+    return BITMAP_ERROR;
+  page_idx = pg_no (list_front (&pool->free_lists[order]))
+             - pg_no (pool->base);
+  remove_block (pool, page_idx, order);
+
+  /* Split it down to the order requested, freeing the upper
+     halves. */
+  while (order > want_order) 
+    {
+      order--;
+      insert_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
 
-  return page_no >= start_page && page_no < end_page;
+  /* Free the pages beyond those requested. */
+  buddy_free (pool, page_idx + page_cnt,
+              ((size_t) 1 << want_order) - page_cnt);
+  return page_idx;
+}
+
+/* Takes the PAGE_CNT pages starting at PAGE_IDX in POOL, all of
+   which must be free, off the free lists.  Each free block that
+   they overlap is removed, and its pages outside the range are
+   returned to the free lists. */
+static void
+buddy_claim (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  size_t end_idx = page_idx + page_cnt;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (page_idx < end_idx) 
+    {
+      size_t block_idx, block_end;
+      int order;
+
+      /* Find the free block that contains PAGE_IDX. */
+      for (order = 0; ; order++) 
+        {
+          ASSERT (order < MAX_ORDER);
+          block_idx = page_idx & ~(((size_t) 1 << order) - 1);
+          if (pool->free_order[block_idx] == order)
+            break;
+        }
+      block_end = block_idx + ((size_t) 1 << order);
+      remove_block (pool, block_idx, order);
+
+      /* Give back the parts of the block outside the range. */
+      buddy_free (pool, block_idx, page_idx - block_idx);
+      if (block_end > end_idx) 
+        {
+          buddy_free (pool, end_idx, block_end - end_idx);
+          block_end = end_idx;
+        }
+      page_idx = block_end;
+    }
+}
+
+/* Returns the PAGE_CNT pages starting at PAGE_IDX in POOL to the
+   free lists, as a series of the largest blocks that are aligned
+   on their size. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0) 
+    {
+      int order = bsr (page_cnt);
+      if (page_idx != 0 && bsf (page_idx) < order)
+        order = bsf (page_idx);
+      if (order > MAX_ORDER - 1)
+        order = MAX_ORDER - 1;
+
+      insert_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Adds a zeroed page to POOL's stash, unless the stash is full
+   or POOL has no free pages.  The page is zeroed with interrupts
+   on.  Returns true if a page was added, false otherwise. */
+static bool
+zero_page (struct pool *pool) 
+{
+  enum intr_level old_level;
+  size_t page_idx;
+  void *page;
+
+  old_level = intr_disable ();
+  page_idx = BITMAP_ERROR;
+  if (pool->zeroed_cnt < ZERO_STASH_PAGES) 
+    {
+      page_idx = buddy_alloc (pool, 1);
+      if (page_idx != BITMAP_ERROR)
+        bitmap_mark (pool->used_map, page_idx);
+    }
+  intr_set_level (old_level);
+  if (page_idx == BITMAP_ERROR)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  list_push_back (&pool->zeroed, page);
+  pool->zeroed_cnt++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Returns all of the pages in POOL's stash of zeroed pages to
+   its free lists. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&pool->zeroed)) 
+    {
+      void *page = list_pop_front (&pool->zeroed);
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+  pool->zeroed_cnt = 0;
+}
+
+#ifdef MEM_TRACK
+#undef palloc_get_multiple
+#undef palloc_get_page
+#undef palloc_free_multiple
+#undef palloc_free_page
+
+/* Tracked version of palloc_get_multiple(). */
+void *
+palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) 
+{
+  void *pages = palloc_get_multiple_untracked (flags, page_cnt);
+  memtrack_alloc (pages, page_cnt * PGSIZE, __builtin_return_address (0));
+  return pages;
+}
+
+/* Tracked version of palloc_get_page(). */
+void *
+palloc_get_page (enum palloc_flags flags) 
+{
+  void *page = palloc_get_page_untracked (flags);
+  memtrack_alloc (page, PGSIZE, __builtin_return_address (0));
+  return page;
+}
+
+/* Tracked version of palloc_free_multiple(). */
+void
+palloc_free_multiple (void *pages, size_t page_cnt) 
+{
+  memtrack_free (pages);
+  palloc_free_multiple_untracked (pages, page_cnt);
+}
+
+/* Tracked version of palloc_free_page(). */
+void
+palloc_free_page (void *page) 
+{
+  memtrack_free (page);
+  palloc_free_page_untracked (page);
 }
+#endif /* MEM_TRACK */
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +12,26 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Free page watermarks for balancing the pools. */
+extern size_t palloc_low_watermark;
+extern size_t palloc_high_watermark;
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+bool palloc_extend (void *, size_t page_cnt, size_t new_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_zero_idle (void);
+void palloc_print_stats (void);
+
+#ifdef MEM_TRACK
+/* Versions of the above that memtrack does not see, for
+   allocators built on pages that charge their own callers. */
+void *palloc_get_page_untracked (enum palloc_flags);
+void *palloc_get_multiple_untracked (enum palloc_flags, size_t page_cnt);
+void palloc_free_page_untracked (void *);
+void palloc_free_multiple_untracked (void *, size_t page_cnt);
+#endif
 
 #endif /* threads/palloc.h */
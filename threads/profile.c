@@ -0,0 +1,112 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Sampling profiler.
+
+   At each timer tick, profile_sample() records the address of
+   the instruction that the timer interrupted in a fixed-size
+   hash table that maps addresses to sample counts.  The table is
+   statically allocated and probed a bounded number of times, so
+   a sample costs a small, fixed amount of time and never
+   allocates memory.  Samples whose address finds no free
+   bucket within PROFILE_PROBES probes are only counted.
+
+   At shutdown, profile_print_stats() prints each sampled address
+   with its count, most frequent first, one per line prefixed by
+   "Profile:".  utils/pintos-profile turns these lines into a flat
+   profile by function. */
+
+/* Number of hash buckets.  Must be a power of 2. */
+#define PROFILE_BITS 12
+#define PROFILE_BUCKETS (1 << PROFILE_BITS)
+
+/* Maximum number of buckets examined per sample. */
+#define PROFILE_PROBES 8
+
+/* A sampled address and its number of samples. */
+struct profile_bucket 
+  {
+    uintptr_t eip;              /* Address, or 0 if bucket unused. */
+    unsigned cnt;               /* Number of samples. */
+  };
+
+static struct profile_bucket buckets[PROFILE_BUCKETS];
+static unsigned kernel_samples; /* Samples in kernel mode. */
+static unsigned user_samples;   /* Samples in user mode. */
+static unsigned dropped_samples; /* Samples that found no bucket. */
+
+bool profile_enabled;
+
+static int bucket_compare (const void *, const void *);
+
+/* Records a sample of the instruction that was executing when
+   the timer interrupt described by F arrived.  Called by the
+   timer interrupt handler, so it must be fast. */
+void
+profile_sample (const struct intr_frame *f) 
+{
+  uintptr_t eip = (uintptr_t) f->eip;
+  unsigned hash;
+  int i;
+
+  ASSERT (intr_context ());
+
+  if (!profile_enabled)
+    return;
+
+  if ((f->cs & 3) == 3)
+    user_samples++;
+  else
+    kernel_samples++;
+
+  /* Fibonacci hashing on the address. */
+  hash = (eip * 2654435761u) >> (32 - PROFILE_BITS);
+  for (i = 0; i < PROFILE_PROBES; i++) 
+    {
+      struct profile_bucket *b;
+
+      b = &buckets[(hash + i) & (PROFILE_BUCKETS - 1)];
+      if (b->eip == eip || b->eip == 0) 
+        {
+          b->eip = eip;
+          b->cnt++;
+          return;
+        }
+    }
+  dropped_samples++;
+}
+
+/* Prints profiling statistics, and every sampled address with its
+   count, most frequent first.  Sorts the table in place, so no
+   more samples are taken afterward. */
+void
+profile_print_stats (void) 
+{
+  int i;
+
+  if (!profile_enabled)
+    return;
+  profile_enabled = false;
+
+  printf ("Profile: %u samples (%u kernel, %u user), %u dropped\n",
+          kernel_samples + user_samples, kernel_samples, user_samples,
+          dropped_samples);
+  qsort (buckets, PROFILE_BUCKETS, sizeof *buckets, bucket_compare);
+  for (i = 0; i < PROFILE_BUCKETS && buckets[i].cnt > 0; i++)
+    printf ("Profile: 0x%08"PRIxPTR" %u\n", buckets[i].eip, buckets[i].cnt);
+}
+
+/* qsort() comparison function that orders buckets by descending
+   sample count. */
+static int
+bucket_compare (const void *a_, const void *b_) 
+{
+  const struct profile_bucket *a = a_;
+  const struct profile_bucket *b = b_;
+
+  return a->cnt < b->cnt ? 1 : a->cnt > b->cnt ? -1 : 0;
+}
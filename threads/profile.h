@@ -0,0 +1,16 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* If false (default), no profiling samples are taken.
+   If true, the timer interrupt samples the interrupted
+   instruction at every tick.
+   Controlled by kernel command-line option "-profile". */
+extern bool profile_enabled;
+
+void profile_sample (const struct intr_frame *);
+void profile_print_stats (void);
+
+#endif /* threads/profile.h */
@@ -0,0 +1,321 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/memtrack.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator for objects of a fixed type.
+
+   Each kmem_cache hands out objects of one size, carved out of
+   single pages called "slabs".  Objects are sized exactly,
+   rounded up only to the requested alignment, instead of to a
+   power of 2 as with malloc().
+
+   If the cache has a constructor, it runs once for each object
+   when the object's slab is created, not on every allocation.
+   The caller must return an object to its constructed state
+   before freeing it, so that the next kmem_cache_alloc() can hand
+   it out as is.  To make that possible, a slab's free objects
+   are tracked by a stack of object indexes in the slab header,
+   not by links stored in the objects themselves.
+
+   A slab whose objects are all in use is kept in no list.  A
+   slab with some objects free is on its cache's partial_slabs
+   list.  One completely free slab is kept as empty_slab, to avoid
+   churning pages when objects are freed and allocated in turn;
+   other free slabs are given back to the page allocator. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page.  It is followed
+   by an array of objs_per_slab uint16_t free object indexes and
+   then, at obj_ofs, by the objects themselves. */
+struct slab 
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in partial_slabs. */
+    size_t free_cnt;            /* Number of free objects. */
+  };
+
+#ifdef MEM_TRACK
+/* With MEM_TRACK, the allocation functions below are defined
+   under these names instead, and the wrappers at the end of this
+   file report each call to memtrack.  Slabs come from the
+   untracked page allocator, so that each object is charged to
+   the caller of kmem_cache_alloc() and its slab is not charged
+   again. */
+#define palloc_get_page palloc_get_page_untracked
+#define palloc_free_page palloc_free_page_untracked
+#define kmem_cache_alloc kmem_cache_alloc_untracked
+#define kmem_cache_free kmem_cache_free_untracked
+static void *kmem_cache_alloc_untracked (struct kmem_cache *);
+static void kmem_cache_free_untracked (struct kmem_cache *, void *);
+#endif
+
+/* List of all caches, for statistics. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_release (struct kmem_cache *, struct slab *);
+static uint16_t *slab_free_stack (struct slab *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Creates and returns a cache of objects of SIZE bytes, each
+   aligned on a multiple of ALIGN bytes, which must be a power of
+   2, or on a multiple of the word size if ALIGN is 0.  If CTOR
+   is nonnull, it is used to construct each object.  NAME is used
+   only for statistics; it is not copied.  Returns a null pointer
+   if memory is not available or if SIZE is too large for a slab
+   to hold an object. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor_func *ctor) 
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+  size_t obj_size, obj_cnt, obj_ofs;
+
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT (size > 0);
+  ASSERT (align <= PGSIZE && (align & (align - 1)) == 0);
+
+  /* Fit as many objects in a slab as possible along with the
+     header and its free stack. */
+  obj_size = ROUND_UP (size, align);
+  obj_ofs = 0;
+  for (obj_cnt = (PGSIZE - sizeof (struct slab)) / obj_size; obj_cnt > 0;
+       obj_cnt--) 
+    {
+      obj_ofs = ROUND_UP (sizeof (struct slab) + obj_cnt * sizeof (uint16_t),
+                          align);
+      if (obj_ofs + obj_cnt * obj_size <= PGSIZE)
+        break;
+    }
+  if (obj_cnt == 0)
+    return NULL;
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+  c->name = name;
+  c->obj_size = obj_size;
+  c->objs_per_slab = obj_cnt;
+  c->obj_ofs = obj_ofs;
+  c->ctor = ctor;
+  lock_init (&c->lock);
+  list_init (&c->partial_slabs);
+  c->empty_slab = NULL;
+  c->alloc_cnt = c->free_cnt = 0;
+  c->slab_cnt = c->slab_create_cnt = c->slab_release_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->elem);
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Allocates and returns an object from cache C, in its
+   constructed state if C has a constructor.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  uint16_t idx;
+
+  ASSERT (c != NULL);
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial_slabs))
+    s = list_entry (list_front (&c->partial_slabs), struct slab, elem);
+  else 
+    {
+      if (c->empty_slab != NULL) 
+        {
+          s = c->empty_slab;
+          c->empty_slab = NULL;
+        }
+      else 
+        {
+          s = slab_create (c);
+          if (s == NULL) 
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+
+  idx = slab_free_stack (s)[--s->free_cnt];
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+  c->alloc_cnt++;
+  lock_release (&c->lock);
+
+  return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  If C has a constructor, OBJ must be in its constructed
+   state. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - (uint8_t *) s - c->obj_ofs) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     its constructed state must be preserved. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  slab_free_stack (s)[s->free_cnt++] = idx;
+  if (s->free_cnt == 1)
+    list_push_front (&c->partial_slabs, &s->elem);
+  if (s->free_cnt == c->objs_per_slab) 
+    {
+      list_remove (&s->elem);
+      if (c->empty_slab == NULL)
+        c->empty_slab = s;
+      else
+        slab_release (c, s);
+    }
+  c->free_cnt++;
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each slab cache. */
+void
+kmem_print_stats (void) 
+{
+  struct list_elem *e;
+
+  if (list_empty (&all_caches))
+    return;
+  printf ("Slab: %-10s %6s %5s %8s %8s %6s %7s %8s\n",
+          "cache", "size", "objs", "allocs", "frees", "slabs",
+          "created", "released");
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e)) 
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab: %-10s %6zu %5zu %8u %8u %6u %7u %8u\n",
+              c->name, c->obj_size, c->objs_per_slab, c->alloc_cnt,
+              c->free_cnt, c->slab_cnt, c->slab_create_cnt,
+              c->slab_release_cnt);
+    }
+}
+
+/* Allocates a new slab for cache C, with all of its objects free
+   and constructed.  Returns a null pointer if memory is not
+   available.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) 
+{
+  struct slab *s;
+  uint16_t *free_stack;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+
+  /* Hand out objects in address order. */
+  free_stack = slab_free_stack (s);
+  for (i = 0; i < c->objs_per_slab; i++) 
+    {
+      free_stack[i] = c->objs_per_slab - 1 - i;
+      if (c->ctor != NULL)
+        c->ctor ((uint8_t *) s + c->obj_ofs + i * c->obj_size);
+    }
+
+  c->slab_cnt++;
+  c->slab_create_cnt++;
+  return s;
+}
+
+/* Gives slab S, whose objects are all free, back to the page
+   allocator.  C's lock must be held. */
+static void
+slab_release (struct kmem_cache *c, struct slab *s) 
+{
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (s->free_cnt == c->objs_per_slab);
+
+  s->magic = 0;
+  palloc_free_page (s);
+  c->slab_cnt--;
+  c->slab_release_cnt++;
+}
+
+/* Returns the stack of free object indexes in slab S. */
+static uint16_t *
+slab_free_stack (struct slab *s) 
+{
+  return (uint16_t *) (s + 1);
+}
+
+/* Returns the slab that contains OBJ, which must be an object
+   allocated from cache C. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+
+  return s;
+}
+
+#ifdef MEM_TRACK
+#undef kmem_cache_alloc
+#undef kmem_cache_free
+
+/* Tracked version of kmem_cache_alloc(). */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  void *obj = kmem_cache_alloc_untracked (c);
+  memtrack_alloc (obj, c->obj_size, __builtin_return_address (0));
+  return obj;
+}
+
+/* Tracked version of kmem_cache_free(). */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  memtrack_free (obj);
+  kmem_cache_free_untracked (c, obj);
+}
+#endif /* MEM_TRACK */
@@ -0,0 +1,42 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Size of a CPU cache line, for use as an alignment. */
+#define CACHE_LINE_SIZE 64
+
+/* Object constructor, called once for each object when its slab
+   is created. */
+typedef void kmem_ctor_func (void *obj);
+
+/* A cache of objects of a single size. */
+struct kmem_cache 
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded up for alignment. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or a null pointer. */
+    struct lock lock;           /* Protects the members below. */
+    struct list partial_slabs;  /* Slabs with free and used objects. */
+    struct slab *empty_slab;    /* A completely free slab, if any. */
+    struct list_elem elem;      /* Element in list of all caches. */
+
+    /* Statistics. */
+    unsigned alloc_cnt;         /* Objects allocated. */
+    unsigned free_cnt;          /* Objects freed. */
+    unsigned slab_cnt;          /* Slabs currently in the cache. */
+    unsigned slab_create_cnt;   /* Slabs created. */
+    unsigned slab_release_cnt;  /* Slabs released. */
+  };
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
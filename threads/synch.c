@@ -27,10 +27,17 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCK_PROFILE
+#include "devices/timer.h"
+
+/* The rest of this file defines lock_init() itself. */
+#undef lock_init
+#endif
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -102,7 +109,11 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  Among waiters of equal priority, the one that
+   has waited longest is woken.  If the woken thread has a higher
+   priority than the running thread, the running thread yields,
+   unless interrupts were already disabled by the caller.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,13 +125,26 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
   intr_set_level (old_level);
+
+  if (old_level == INTR_ON || intr_context ())
+    thread_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
+static void lock_donate_priority (struct lock *, int priority);
+static void lock_take (struct lock *);
+#ifdef LOCK_PROFILE
+static void lock_profile_acquired (struct lock *, int64_t wait_start);
+static void lock_profile_released (struct lock *);
+#endif
 
 /* Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
@@ -171,20 +195,40 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   Because a lock has an owner, a thread that blocks on a lock
+   donates its priority to the holder, so that a low-priority
+   holder cannot keep a high-priority waiter from running
+   indefinitely. */
 void
 lock_init (struct lock *lock)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
+  lock->max_priority = PRI_MIN;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCK_PROFILE
+  lock->profile = NULL;
+#endif
 }
 
+/* Maximum number of locks that a priority donation is passed
+   along, starting from the lock being acquired.  Bounds the
+   time spent with interrupts off in lock_acquire(), at the cost
+   of not donating through longer chains of locks. */
+#define LOCK_DONATE_DEPTH 8
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   If LOCK is held, the current thread donates its priority to
+   the holder, to the holder of the lock that the holder is
+   waiting for, and so on, up to LOCK_DONATE_DEPTH locks.  The
+   4.4BSD scheduler does not use donation.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -192,12 +236,80 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+#ifdef LOCK_PROFILE
+  int64_t wait_start;
+#endif
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+#ifdef LOCK_PROFILE
+  wait_start = lock->holder != NULL ? timer_now_ns () : -1;
+#endif
+  if (lock->holder != NULL && !thread_mlfqs) 
+    {
+      cur->waiting_lock = lock;
+      lock_donate_priority (lock, cur->priority);
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->waiting_lock = NULL;
+  lock_take (lock);
+#ifdef LOCK_PROFILE
+  lock_profile_acquired (lock, wait_start);
+#endif
+  intr_set_level (old_level);
+}
+
+/* Donates PRIORITY along the chain of lock holders that starts
+   at LOCK.  Stops early at a lock that already has a waiter of
+   at least PRIORITY, since the rest of the chain has received
+   that donation already. */
+static void
+lock_donate_priority (struct lock *lock, int priority) 
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; lock != NULL && depth < LOCK_DONATE_DEPTH; depth++) 
+    {
+      if (lock->max_priority >= priority)
+        break;
+      lock->max_priority = priority;
+
+      if (lock->holder == NULL)
+        break;
+      thread_update_priority (lock->holder);
+      lock = lock->holder->waiting_lock;
+    }
+}
+
+/* Makes the current thread the holder of LOCK, which it has just
+   downed, and takes over the donations of the threads still
+   waiting for LOCK. */
+static void
+lock_take (struct lock *lock) 
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->holder = cur;
+  lock->max_priority = PRI_MIN;
+  for (e = list_begin (&lock->semaphore.waiters);
+       e != list_end (&lock->semaphore.waiters); e = list_next (e)) 
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+      if (t->priority > lock->max_priority)
+        lock->max_priority = t->priority;
+    }
+  list_push_back (&cur->held_locks, &lock->elem);
+  thread_update_priority (cur);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -209,14 +321,22 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
-  if (success)
-    lock->holder = thread_current ();
+  if (success) 
+    {
+      lock_take (lock);
+#ifdef LOCK_PROFILE
+      lock_profile_acquired (lock, -1);
+#endif
+    }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -224,15 +344,33 @@ lock_try_acquire (struct lock *lock)
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
-   handler. */
+   handler.
+
+   The current thread gives up the donations it received through
+   LOCK, which may lower its priority and cause it to yield.  The
+   semaphore is upped before interrupts go back on, so that no
+   thread can find LOCK without a holder and yet unavailable,
+   and so block on it without donating to anyone. */
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+#ifdef LOCK_PROFILE
+  lock_profile_released (lock);
+#endif
   lock->holder = NULL;
+  list_remove (&lock->elem);
+  thread_update_priority (thread_current ());
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
+
+  if (old_level == INTR_ON)
+    thread_preempt ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -246,13 +384,122 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+#ifdef LOCK_PROFILE
+/* Registry of lock_init() call sites, in order of first use. */
+static struct list lock_registry = LIST_INITIALIZER (lock_registry);
+
+/* Number of sites printed by lock_print_stats(). */
+#define LOCK_PROFILE_TOP 10
+
+static list_less_func lock_profile_less;
+
+/* Initializes LOCK, as lock_init() does, and attaches it to the
+   statistics in PROFILE, registering PROFILE if this is the
+   first lock initialized at its call site. */
+void
+lock_profile_init (struct lock *lock, struct lock_profile *profile) 
+{
+  enum intr_level old_level;
+
+  lock_init (lock);
+  lock->profile = profile;
+
+  old_level = intr_disable ();
+  if (!profile->registered) 
+    {
+      list_push_back (&lock_registry, &profile->elem);
+      profile->registered = true;
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the current thread acquired LOCK, after waiting
+   since WAIT_START, or without waiting if WAIT_START is -1. */
+static void
+lock_profile_acquired (struct lock *lock, int64_t wait_start) 
+{
+  struct lock_profile *p = lock->profile;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->acquire_ns = timer_now_ns ();
+  if (p == NULL)
+    return;
+  p->acquire_cnt++;
+  if (wait_start >= 0) 
+    {
+      int64_t wait_ns = lock->acquire_ns - wait_start;
+      p->contended_cnt++;
+      p->wait_ns += wait_ns;
+      if (wait_ns > p->max_wait_ns)
+        p->max_wait_ns = wait_ns;
+    }
+}
+
+/* Records that the current thread is releasing LOCK. */
+static void
+lock_profile_released (struct lock *lock) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (lock->profile != NULL)
+    lock->profile->hold_ns += timer_now_ns () - lock->acquire_ns;
+}
+
+/* Prints the LOCK_PROFILE_TOP lock sites with the most total
+   time spent waiting. */
+void
+lock_print_stats (void) 
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+  int i;
+
+  old_level = intr_disable ();
+  list_sort (&lock_registry, lock_profile_less, NULL);
+  intr_set_level (old_level);
+
+  printf ("Locks: %zu sites, by total wait (times in us):\n",
+          list_size (&lock_registry));
+  printf ("%10s %10s %10s %10s %10s  %s\n",
+          "acquires", "contended", "wait", "max wait", "hold", "site");
+  for (e = list_begin (&lock_registry), i = 0;
+       e != list_end (&lock_registry) && i < LOCK_PROFILE_TOP;
+       e = list_next (e), i++) 
+    {
+      struct lock_profile *p = list_entry (e, struct lock_profile, elem);
+      printf ("%10u %10u %10"PRId64" %10"PRId64" %10"PRId64"  %s (%s:%d)\n",
+              p->acquire_cnt, p->contended_cnt, p->wait_ns / 1000,
+              p->max_wait_ns / 1000, p->hold_ns / 1000,
+              p->name, p->file, p->line);
+    }
+}
+
+/* Orders lock profiles by descending total wait time, then by
+   descending number of acquisitions. */
+static bool
+lock_profile_less (const struct list_elem *a_, const struct list_elem *b_,
+                   void *aux UNUSED) 
+{
+  const struct lock_profile *a = list_entry (a_, struct lock_profile, elem);
+  const struct lock_profile *b = list_entry (b_, struct lock_profile, elem);
+
+  if (a->wait_ns != b->wait_ns)
+    return a->wait_ns > b->wait_ns;
+  return a->acquire_cnt > b->acquire_cnt;
+}
+#endif /* LOCK_PROFILE */
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static list_less_func semaphore_elem_less;
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -295,6 +542,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -302,8 +550,9 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the one with the highest priority to
+   wake up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -317,8 +566,12 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      semaphore_elem_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,3 +589,188 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Returns true if the thread waiting on semaphore_elem A_ has a
+   lower priority than the one waiting on B_, false otherwise. */
+static bool
+semaphore_elem_less (const struct list_elem *a_,
+                     const struct list_elem *b_, void *aux UNUSED) 
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  return a->thread->priority < b->thread->priority;
+}
+
+/* A thread waiting for a reader-writer lock. */
+struct rw_waiter 
+  {
+    struct list_elem elem;              /* List element. */
+    struct thread *thread;              /* Waiting thread. */
+    bool writer;                        /* Waiting to write? */
+  };
+
+static void rw_wait (struct rwlock *, bool writer);
+static void rw_grant (struct rwlock *);
+
+/* Initializes RW.  A reader-writer lock can be held either by
+   any number of readers at once or by a single writer.
+
+   Threads that cannot get the lock at once queue up in arrival
+   order, and the lock is handed off directly to the front of the
+   queue: to a single writer, or to every reader up to the next
+   waiting writer.  A reader also queues up whenever any thread
+   is already waiting, so a steady stream of readers cannot
+   starve a writer, and FIFO handoff keeps writers from starving
+   readers.  Because of the handoff, a woken thread already holds
+   the lock, and if it has a higher priority than the releasing
+   thread then it runs at once. */
+void
+rw_init (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  list_init (&rw->waiters);
+}
+
+/* Acquires RW for reading, sleeping until it becomes available
+   if necessary.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_read_acquire (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer != NULL || !list_empty (&rw->waiters))
+    rw_wait (rw, false);
+  else
+    rw->readers++;
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rw_read_release (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0)
+    rw_grant (rw);
+  intr_set_level (old_level);
+
+  if (old_level == INTR_ON)
+    thread_preempt ();
+}
+
+/* Acquires RW for writing, sleeping until it becomes available
+   if necessary.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_write_acquire (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer != NULL || rw->readers > 0 || !list_empty (&rw->waiters))
+    rw_wait (rw, true);
+  else
+    rw->writer = thread_current ();
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rw_write_release (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  rw->writer = NULL;
+  rw_grant (rw);
+  intr_set_level (old_level);
+
+  if (old_level == INTR_ON)
+    thread_preempt ();
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rw_write_held_by_current_thread (const struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Queues the current thread on RW as a reader or, if WRITER is
+   true, as a writer, and blocks until rw_grant() hands RW over
+   to it. */
+static void
+rw_wait (struct rwlock *rw, bool writer) 
+{
+  struct rw_waiter waiter;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  waiter.thread = thread_current ();
+  waiter.writer = writer;
+  list_push_back (&rw->waiters, &waiter.elem);
+  thread_block ();
+}
+
+/* Hands RW over to the threads at the front of its queue: to the
+   first waiter if it is a writer and RW is free, otherwise to
+   every reader ahead of the first waiting writer. */
+static void
+rw_grant (struct rwlock *rw) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rw->writer == NULL);
+
+  while (!list_empty (&rw->waiters)) 
+    {
+      struct rw_waiter *w = list_entry (list_front (&rw->waiters),
+                                        struct rw_waiter, elem);
+      struct thread *t = w->thread;
+
+      if (w->writer) 
+        {
+          if (rw->readers == 0) 
+            {
+              rw->writer = t;
+              list_pop_front (&rw->waiters);
+              thread_unblock (t);
+            }
+          break;
+        }
+      rw->readers++;
+      list_pop_front (&rw->waiters);
+      thread_unblock (t);
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -20,8 +21,14 @@ void sema_self_test (void);
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's `held_locks'. */
+    int max_priority;           /* Highest priority among waiters. */
+#ifdef LOCK_PROFILE
+    struct lock_profile *profile; /* Statistics for this lock's site. */
+    int64_t acquire_ns;         /* When the holder acquired the lock. */
+#endif
   };
 
 void lock_init (struct lock *);
@@ -30,6 +37,44 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+#ifdef LOCK_PROFILE
+/* Lock contention profiler, enabled by building with
+   LOCK_PROFILE defined.
+
+   Statistics are kept per lock_init() call site, so that all of
+   the locks initialized by the same line of code, such as the
+   lock in every open inode, add up to one entry.  lock_init() is
+   redefined as a macro that supplies a static lock_profile for
+   its call site, which is registered the first time it is
+   used.  lock_print_stats() prints the sites that spent the most
+   time waiting. */
+struct lock_profile 
+  {
+    const char *name;           /* lock_init() argument, as text. */
+    const char *file;           /* Source file of lock_init() call. */
+    int line;                   /* Line of lock_init() call. */
+    bool registered;            /* In the registry yet? */
+    struct list_elem elem;      /* Element in the registry. */
+    unsigned acquire_cnt;       /* Number of acquisitions. */
+    unsigned contended_cnt;     /* Acquisitions that had to wait. */
+    int64_t wait_ns;            /* Total time spent waiting. */
+    int64_t max_wait_ns;        /* Longest single wait. */
+    int64_t hold_ns;            /* Total time held. */
+  };
+
+void lock_profile_init (struct lock *, struct lock_profile *);
+void lock_print_stats (void);
+
+#define lock_init(LOCK)                                                \
+        do                                                             \
+          {                                                            \
+            static struct lock_profile lock_profile_ =                 \
+              { .name = #LOCK, .file = __FILE__, .line = __LINE__ };   \
+            lock_profile_init (LOCK, &lock_profile_);                  \
+          }                                                            \
+        while (0)
+#endif /* LOCK_PROFILE */
+
 /* Condition variable. */
 struct condition 
   {
@@ -41,6 +86,21 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock. */
+struct rwlock 
+  {
+    int readers;                /* Number of readers holding lock. */
+    struct thread *writer;      /* Writer holding lock, or NULL. */
+    struct list waiters;        /* Waiting readers and writers, FIFO. */
+  };
+
+void rw_init (struct rwlock *);
+void rw_read_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+void rw_write_release (struct rwlock *);
+bool rw_write_held_by_current_thread (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -11,6 +11,7 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,9 +21,18 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Number of distinct thread priorities. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* Run queue: processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  There is one
+   FIFO list per priority, and bit P of ready_mask is set if and
+   only if ready_lists[P] is nonempty, so that the
+   highest-priority ready thread can be found in constant
+   time. */
+static struct list ready_lists[PRI_CNT];
+static uint64_t ready_mask;
+static int ready_cnt;           /* Number of threads in the run queue. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -49,11 +59,17 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long switch_cnt;    /* # of context switches. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* 4.4BSD scheduler. */
+#define PRIORITY_PERIOD 4       /* # of timer ticks between updates. */
+static fixed_t load_avg;        /* System load average. */
+static unsigned second_ticks;   /* # of timer ticks, modulo TIMER_FREQ. */
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -66,6 +82,13 @@ static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void set_priority (struct thread *, int priority);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *, void *aux);
+static void mlfqs_update_recent_cpu (struct thread *, void *coefficient);
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
@@ -87,10 +110,16 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_lists[i]);
+  ready_mask = 0;
+  ready_cnt = 0;
+  load_avg = 0;
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -134,17 +163,111 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (thread_mlfqs) 
+    {
+      mlfqs_tick (t);
+      if (ready_max_priority () > t->priority)
+        intr_yield_on_return ();
+    }
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
+/* Called by timer_idle_exit() for each timer tick that passed
+   while the CPU was idle in tickless mode, without a timer
+   interrupt of its own.  Accounts for the tick as if it had been
+   spent in the idle thread.  Must be called with interrupts
+   off. */
+void
+thread_tick_idle (void) 
+{
+  idle_ticks++;
+  if (thread_mlfqs)
+    mlfqs_tick (idle_thread);
+}
+
+/* Updates the 4.4BSD scheduler's statistics for a timer tick in
+   which T was running.  Per tick, only T's recent_cpu changes,
+   so T is the only thread touched, and every PRIORITY_PERIOD
+   ticks its priority is recomputed.  Once per second, load_avg
+   and every thread's recent_cpu are updated, and every thread's
+   priority is recomputed, which takes time linear in the number
+   of threads.  Other threads' priorities cannot change in
+   between, because they depend only on recent_cpu and nice. */
+static void
+mlfqs_tick (struct thread *t) 
+{
+  if (t != idle_thread)
+    t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+  /* thread_tick() runs on every timer tick since boot, so this
+     stays in step with timer_ticks() % TIMER_FREQ without a
+     64-bit division. */
+  if (++second_ticks >= TIMER_FREQ) 
+    {
+      int ready_threads = ready_cnt + (t != idle_thread);
+      fixed_t coefficient;
+
+      second_ticks = 0;
+
+      /* load_avg = (59/60) * load_avg + (1/60) * ready_threads. */
+      load_avg = (fp_mul (fp_div_int (fp_from_int (59), 60), load_avg)
+                  + fp_div_int (fp_from_int (ready_threads), 60));
+
+      /* recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu
+                      + nice.
+         The coefficient is the same for every thread, so the
+         one fixed-point division is done here. */
+      coefficient = fp_div (fp_mul_int (load_avg, 2),
+                            fp_add_int (fp_mul_int (load_avg, 2), 1));
+      thread_foreach (mlfqs_update_recent_cpu, &coefficient);
+      thread_foreach (mlfqs_update_priority, NULL);
+    }
+  else if (second_ticks % PRIORITY_PERIOD == 0)
+    mlfqs_update_priority (t, NULL);
+}
+
+/* Sets T's recent_cpu from the once-per-second formula, given
+   its COEFFICIENT_, a pointer to a fixed_t. */
+static void
+mlfqs_update_recent_cpu (struct thread *t, void *coefficient_) 
+{
+  fixed_t *coefficient = coefficient_;
+
+  if (t != idle_thread)
+    t->recent_cpu = fp_add_int (fp_mul (*coefficient, t->recent_cpu),
+                                t->nice);
+}
+
+/* Sets T's priority from the 4.4BSD formula
+   PRI_MAX - (recent_cpu / 4) - (nice * 2), clamped to the range
+   of valid priorities. */
+static void
+mlfqs_update_priority (struct thread *t, void *aux UNUSED) 
+{
+  int priority;
+
+  if (t == idle_thread)
+    return;
+
+  priority = (PRI_MAX - fp_round (fp_div_int (t->recent_cpu, 4))
+              - t->nice * 2);
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  set_priority (t, priority);
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
-  printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-          idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks, "
+          "%lld context switches\n",
+          idle_ticks, kernel_ticks, user_ticks, switch_cnt);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -159,9 +282,9 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, it preempts the running thread before thread_create()
+   returns. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
@@ -184,6 +307,19 @@ thread_create (const char *name, int priority,
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
 
+  /* Under the 4.4BSD scheduler, the new thread inherits its
+     parent's niceness and recent_cpu, and PRIORITY is ignored. */
+  if (thread_mlfqs) 
+    {
+      struct thread *cur = thread_current ();
+
+      old_level = intr_disable ();
+      t->nice = cur->nice;
+      t->recent_cpu = cur->recent_cpu;
+      mlfqs_update_priority (t, NULL);
+      intr_set_level (old_level);
+    }
+
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
      member cannot be observed. */
@@ -232,10 +368,14 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   If T has a higher priority than the running thread, the
+   running thread is preempted, but only if that can be done
+   without breaking the caller's atomicity: in an interrupt
+   handler the yield is deferred until the interrupt returns, and
+   if the caller had disabled interrupts itself, it may expect
+   that it can atomically unblock a thread and update other data,
+   so nothing is done and the caller should invoke
+   thread_preempt() once it turns interrupts back on. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -245,9 +385,35 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
+
+  if (old_level == INTR_ON || intr_context ())
+    thread_preempt ();
+}
+
+/* Yields the CPU if some ready thread has a higher priority than
+   the running thread.  In an external interrupt handler, the
+   yield happens when the interrupt returns. */
+void
+thread_preempt (void) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool preempt;
+
+  old_level = intr_disable ();
+  preempt = cur != idle_thread && ready_max_priority () > cur->priority;
+  intr_set_level (old_level);
+
+  if (preempt) 
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
 }
 
 /* Returns the name of the running thread. */
@@ -316,7 +482,7 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+    ready_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -339,11 +505,93 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Returns true if the thread that contains list element A_ has
+   a lower priority than the one that contains B_, false
+   otherwise.  Both elements must be `elem' members of struct
+   thread. */
+bool
+thread_priority_less (const struct list_elem *a_,
+                      const struct list_elem *b_, void *aux UNUSED) 
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority < b->priority;
+}
+
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   thread keeps any higher priority donated to it through the
+   locks it holds until it releases them.  Yields the CPU if the
+   current thread no longer has the highest priority.
+
+   The 4.4BSD scheduler computes priorities itself, so it ignores
+   this call. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Recomputes T's priority as the maximum of its base priority
+   and the priorities donated to it through the locks it holds,
+   moving T to the right place in the run queue if it is ready.
+   Takes time proportional to the number of locks T holds.  Does
+   nothing under the 4.4BSD scheduler, which has no donation.
+
+   This function must be called with interrupts turned off. */
+void
+thread_update_priority (struct thread *t) 
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct lock *l = list_entry (e, struct lock, elem);
+      if (l->max_priority > priority)
+        priority = l->max_priority;
+    }
+  set_priority (t, priority);
+}
+
+/* Changes T's priority to PRIORITY, moving T to the right place
+   in the run queue if it is ready. */
+static void
+set_priority (struct thread *t, int priority) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority != t->priority) 
+    {
+      if (t->status == THREAD_READY) 
+        {
+          ready_remove (t);
+          t->priority = priority;
+          ready_push (t);
+        }
+      else
+        t->priority = priority;
+    }
 }
 
 /* Returns the current thread's priority. */
@@ -353,35 +601,52 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority.  Yields the CPU if the current thread no longer
+   has the highest priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur, NULL);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu,
+                                             100));
+  intr_set_level (old_level);
+  return recent_cpu_100;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -391,8 +656,8 @@ thread_get_recent_cpu (void)
    point it initializes idle_thread, "up"s the semaphore passed
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   run queue.  It is returned by next_thread_to_run() as a
+   special case when the run queue is empty. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
@@ -406,6 +671,18 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Zero some free pages for later PAL_ZERO requests.  A
+         thread woken meanwhile does not preempt the idle thread,
+         so check for one before halting. */
+      intr_enable ();
+      palloc_zero_idle ();
+      intr_disable ();
+      if (ready_cnt > 0)
+        continue;
+
+      /* Stop the periodic timer interrupt, if tickless. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -467,7 +744,11 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+#ifdef VM
+  list_init (&t->mappings);
+#endif
   t->magic = THREAD_MAGIC;
   list_push_back (&all_list, &t->allelem);
 }
@@ -485,18 +766,83 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Adds T to the back of the run queue for its priority. */
+static void
+ready_push (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_lists[t->priority - PRI_MIN], &t->elem);
+  ready_mask |= (uint64_t) 1 << (t->priority - PRI_MIN);
+  ready_cnt++;
+}
+
+/* Removes T, which must be ready, from the run queue. */
+static void
+ready_remove (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_lists[t->priority - PRI_MIN]))
+    ready_mask &= ~((uint64_t) 1 << (t->priority - PRI_MIN));
+  ready_cnt--;
+}
+
+/* Returns the index of the most significant set bit in X, which
+   must be nonzero.  See [IA32-v2a] "BSR--Bit Scan Reverse". */
+static inline int
+bsr (uint32_t x) 
+{
+  int idx;
+  asm ("bsrl %1, %0" : "=r" (idx) : "rm" (x));
+  return idx;
+}
+
+/* Returns the priority of the highest-priority thread in the run
+   queue, or PRI_MIN - 1 if the run queue is empty. */
+static int
+ready_max_priority (void) 
+{
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (high != 0)
+    return PRI_MIN + 32 + bsr (high);
+  else if (low != 0)
+    return PRI_MIN + bsr (low);
+  else
+    return PRI_MIN - 1;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   idle_thread.
+
+   The thread chosen is the one that has waited longest among
+   those with the highest priority. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int priority = ready_max_priority ();
+  struct list *list;
+  struct thread *next;
+
+  if (priority < PRI_MIN)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  list = &ready_lists[priority - PRI_MIN];
+  next = list_entry (list_pop_front (list), struct thread, elem);
+  if (list_empty (list))
+    ready_mask &= ~((uint64_t) 1 << (priority - PRI_MIN));
+  ready_cnt--;
+  return next;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -563,8 +909,13 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (cur == idle_thread)
+    timer_idle_exit ();
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      switch_cnt++;
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
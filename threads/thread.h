@@ -2,8 +2,10 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -24,6 +26,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the 4.4BSD scheduler. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -74,12 +81,13 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member has a triple purpose.  It can be an element
+   in the run queue (thread.c), an element in a semaphore wait
+   list (synch.c), or an element in the timer's sleep list
+   (devices/timer.c).  It can be used these three ways only
+   because they are mutually exclusive: only a thread in the
+   ready state is on the run queue, whereas a blocked thread
+   waits either on a semaphore or for the timer, never both. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -87,17 +95,43 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
+    int base_priority;                  /* Priority before donations. */
     struct list_elem allelem;           /* List element for all threads list. */
 
-    /* Shared between thread.c and synch.c. */
+    /* Shared between thread.c, synch.c, and devices/timer.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by thread.c, for the 4.4BSD scheduler. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recent CPU time received. */
+
+    /* Shared between thread.c and synch.c. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being acquired, if any. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if asleep. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 #endif
 
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    uint8_t *last_fault;                /* Page of last page fault. */
+    size_t fault_window;                /* Pages to map after a fault. */
+
+    /* Owned by userprog/process.c. */
+    struct file *exec_file;             /* Executable, kept open. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next map region identifier. */
+#endif
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -111,6 +145,7 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_tick_idle (void);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -118,6 +153,7 @@ tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_preempt (void);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -130,8 +166,12 @@ void thread_yield (void);
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+bool thread_priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -20,9 +24,10 @@ static void page_fault (struct intr_frame *);
    signals.  Instead, we'll make them simply kill the user
    process.
 
-   Page faults are an exception.  Here they are treated the same
-   way as other exceptions, but this will need to change to
-   implement virtual memory.
+   Page faults are an exception.  With VM, a fault on a page that
+   the process's supplemental page table knows about brings that
+   page in; any other page fault is treated the same way as
+   other exceptions.
 
    Refer to [IA32-v3a] section 5.15 "Exception and Interrupt
    Reference" for a description of each of these exceptions. */
@@ -148,9 +153,20 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* A user page that is not present may simply not have been
+     loaded yet.  The kernel can fault on one too, while it
+     accesses user memory on a process's behalf.  A kernel thread
+     has no page directory and no supplemental page table, so any
+     fault there is a bug. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && thread_current ()->pagedir != NULL && page_in (fault_addr))
+    return;
+#endif
+
+  /* The fault is a real error: either page_in() could not
+     resolve it, or this kernel has no virtual memory.  Report it
+     and kill the offender. */
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -23,7 +23,10 @@ pagedir_create (void)
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  With VM, process_exit() has already unmapped each
+   user page through the supplemental page table, which frees a
+   shared frame only when its last user lets go of it, so no user
+   page remains here to be freed. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -33,6 +36,9 @@ pagedir_destroy (uint32_t *pd)
     return;
 
   ASSERT (pd != init_page_dir);
+
+  /* Only the user part of PD is ours to free.  The kernel part,
+     including any 4 MB pages, is shared with init_page_dir. */
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P) 
       {
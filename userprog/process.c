@@ -17,6 +17,10 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
@@ -98,6 +102,18 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+#ifdef VM
+  /* Write back and close memory-mapped files.  Then release the
+     supplemental page table, with the frames and swap slots
+     behind it, while the page directory that maps those frames
+     still exists, and then the executable that no page can be
+     loaded from any more. */
+  mmap_unmap_all ();
+  page_table_destroy (&cur->pages);
+  file_close (cur->exec_file);
+  cur->exec_file = NULL;
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -220,6 +236,10 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    goto done;
+#endif
 
   /* Open executable file. */
   file = filesys_open (file_name);
@@ -312,13 +332,27 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* Pages are read from FILE on demand, so it has to stay open,
+     and unchanged, for as long as the process runs. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->exec_file = file;
+    }
+  else
+    file_close (file);
+#else
   file_close (file);
+#endif
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -377,6 +411,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only recorded in the supplemental page
+   table here; each one is read in when the process first
+   touches it.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -396,6 +434,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where this page comes from. */
+      if (!page_add_file (upage, file, ofs, page_read_bytes,
+                          page_zero_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -415,6 +460,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -429,6 +475,16 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  /* The stack page is recorded in the supplemental page table
+     like any other, so that it can be evicted. */
+  if (!page_add_zero (upage, true) || !page_in (upage))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -442,8 +498,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +521,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
@@ -0,0 +1,533 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Frame table.  FRAME_LOCK protects the table and the clock
+   hand, the members of every struct frame, and the FRAME member
+   of every struct page.  It protects the share cache as well.
+   It is released while a page is written out, with the frame
+   marked IO, and whoever needs that page in the meantime waits
+   for the write to finish, so that a page cannot be freed or
+   brought back in while it is being evicted. */
+static struct list frames;      /* All frames holding user pages. */
+static size_t frame_cnt;        /* Number of elements in FRAMES. */
+static struct list_elem *hand;  /* Next frame for the clock to visit. */
+static struct lock frame_lock;
+
+/* Share cache.
+
+   Read-only pages of executables are the same in every process
+   that runs them, so they are kept in one frame apiece, mapped
+   into every page directory that uses them.  They are found by
+   the inode sector of the file and the offset and length of the
+   data read from it. */
+struct share
+  {
+    struct hash_elem elem;      /* Element in SHARES. */
+    struct share_key
+      {
+        block_sector_t sector;  /* Inode sector of the file. */
+        off_t ofs;              /* Offset in the file. */
+        uint32_t read_bytes;    /* Bytes read from the file. */
+      }
+    key;
+    struct frame *frame;        /* Frame, or null if not resident. */
+    struct list mappers;        /* Pages that map FRAME. */
+    unsigned ref_cnt;           /* Pages that refer to this. */
+  };
+
+static struct hash shares;      /* All shares, keyed by KEY. */
+static size_t map_cnt;          /* Pages mapping shared frames. */
+static size_t shared_cnt;       /* Frames holding shared pages. */
+
+/* Caches of struct frame and struct share. */
+static struct kmem_cache *frame_cache;
+static struct kmem_cache *share_cache;
+
+/* Statistics. */
+static long long evict_cnt;     /* Pages evicted. */
+static long long share_read_cnt; /* Shared pages read in. */
+static long long share_hit_cnt; /* Shared pages found resident. */
+static size_t peak_saved_cnt;   /* Most frames saved by sharing. */
+
+static struct frame *get_frame (enum palloc_flags, bool evict);
+static void release_frame (struct frame *);
+static struct frame *evict_frame (void);
+static bool evict_page (struct frame *);
+static void wait_for_io (struct page *);
+static bool evict_shared (struct frame *);
+static void unshare (struct page *);
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  lock_init (&frame_lock);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), 0, NULL);
+  share_cache = kmem_cache_create ("share", sizeof (struct share), 0, NULL);
+  if (!hash_init (&shares, share_hash, share_less, NULL))
+    PANIC ("out of memory for share cache");
+}
+
+/* Obtains a frame for page P of the current process, from the
+   user pool if it has a free page and otherwise, if EVICT is
+   true, by evicting another page.  If FLAGS includes PAL_ZERO,
+   the frame is zeroed.  The frame is returned pinned, so that P
+   can be read into it and mapped before it becomes a candidate
+   for eviction itself; call frame_unpin() once that is done.
+
+   Returns a null pointer if no frame can be found, which happens
+   only if the user pool is empty and EVICT is false, or every
+   frame is pinned or holds a modified page that cannot be
+   swapped out. */
+struct frame *
+frame_alloc (struct page *p, enum palloc_flags flags, bool evict)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_for_io (p);
+  ASSERT (p->frame == NULL);
+  ASSERT (p->share == NULL);
+  f = get_frame (flags, evict);
+  if (f != NULL)
+    {
+      f->pd = thread_current ()->pagedir;
+      f->page = p;
+      f->pinned = true;
+      p->frame = f;
+    }
+  lock_release (&frame_lock);
+
+  return f;
+}
+
+/* Brings read-only page P of the current process in through the
+   share cache and maps it.  If another process already has the
+   same page of the same file in memory, P is mapped to that
+   frame; otherwise a frame is obtained as by frame_alloc(),
+   evicting another page only if EVICT is true, and read from
+   P's file.  Returns true if successful, false if no frame can
+   be found or if the disk read fails.
+
+   The frame table lock is released during the disk read.  The
+   frame is already in the share meanwhile, pinned and marked IO,
+   so that other processes that want the same page wait for the
+   read to finish instead of reading it again, and processes
+   that want other pages do not wait at all. */
+bool
+frame_alloc_shared (struct page *p, bool evict)
+{
+  struct share *s;
+  bool loaded = false;
+  bool success = false;
+
+  ASSERT (!p->writable);
+  ASSERT (p->read_bytes > 0);
+
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame == NULL);
+
+  /* Find or create the share, and take a reference to it that
+     lasts until P is destroyed. */
+  if (p->share == NULL)
+    {
+      struct share key;
+      struct hash_elem *e;
+
+      memset (&key.key, 0, sizeof key.key);
+      key.key.sector = inode_get_inumber (file_get_inode (p->file));
+      key.key.ofs = p->ofs;
+      key.key.read_bytes = p->read_bytes;
+      e = hash_find (&shares, &key.elem);
+      if (e != NULL)
+        s = hash_entry (e, struct share, elem);
+      else
+        {
+          s = kmem_cache_alloc (share_cache);
+          if (s == NULL)
+            goto done;
+          s->key = key.key;
+          s->frame = NULL;
+          list_init (&s->mappers);
+          s->ref_cnt = 0;
+          hash_insert (&shares, &s->elem);
+        }
+      s->ref_cnt++;
+      p->share = s;
+    }
+  s = p->share;
+
+  /* Bring the page into memory, unless another process already
+     has or is doing so.  get_frame() may release FRAME_LOCK to
+     evict a page, so S must be checked again afterward. */
+  while (s->frame == NULL || s->frame->io)
+    {
+      struct frame *f;
+      bool ok;
+
+      if (s->frame != NULL)
+        {
+          cond_wait (&s->frame->io_done, &frame_lock);
+          continue;
+        }
+      f = get_frame (PAL_USER, evict);
+      if (f == NULL)
+        goto done;
+      if (s->frame != NULL)
+        {
+          release_frame (f);
+          continue;
+        }
+
+      f->pd = NULL;
+      f->page = NULL;
+      f->share = s;
+      f->pinned = f->io = true;
+      s->frame = f;
+      lock_release (&frame_lock);
+      ok = (file_read_at (p->file, f->kpage, p->read_bytes, p->ofs)
+            == (off_t) p->read_bytes);
+      if (ok)
+        memset ((uint8_t *) f->kpage + p->read_bytes, 0, p->zero_bytes);
+      lock_acquire (&frame_lock);
+      f->pinned = f->io = false;
+      cond_broadcast (&f->io_done, &frame_lock);
+      if (!ok)
+        {
+          s->frame = NULL;
+          release_frame (f);
+          goto done;
+        }
+      shared_cnt++;
+      share_read_cnt++;
+      loaded = true;
+    }
+  if (!loaded)
+    share_hit_cnt++;
+
+  /* Map it. */
+  if (!pagedir_set_page (p->pd, p->upage, s->frame->kpage, false))
+    goto done;
+  list_push_back (&s->mappers, &p->share_elem);
+  p->frame = s->frame;
+  map_cnt++;
+  if (map_cnt - shared_cnt > peak_saved_cnt)
+    peak_saved_cnt = map_cnt - shared_cnt;
+  success = true;
+
+ done:
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Allows frame F to be evicted. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pinned);
+  f->pinned = false;
+  lock_release (&frame_lock);
+}
+
+/* Unmaps page P and frees its frame, if it has one, or drops its
+   reference to a shared frame.  A modified page of a
+   memory-mapped file is written back first.  If P is being
+   evicted, waits for that to finish first. */
+void
+frame_free (struct page *p)
+{
+  lock_acquire (&frame_lock);
+  wait_for_io (p);
+  if (p->share != NULL)
+    unshare (p);
+  else if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+
+      /* A memory-mapped page's changes must reach its file.  No
+         swap slot is involved, so this cannot fail. */
+      if (p->mmap)
+        evict_page (f);
+      else
+        {
+          pagedir_clear_page (f->pd, p->upage);
+          p->frame = NULL;
+        }
+      release_frame (f);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %lld evictions\n", frame_cnt, evict_cnt);
+  printf ("Sharing: %lld pages read in, %lld hits, %zu pages saved "
+          "at peak\n", share_read_cnt, share_hit_cnt, peak_saved_cnt);
+}
+
+/* Returns a frame, unpinned and in the frame table, from the
+   user pool or, if EVICT is true, by evicting a page.  If FLAGS
+   includes PAL_ZERO, the frame is zeroed.  Returns a null
+   pointer if no frame can be found.  The caller must fill in
+   the frame's owner.
+
+   Must be called with FRAME_LOCK held. */
+static struct frame *
+get_frame (enum palloc_flags flags, bool evict)
+{
+  struct frame *f;
+  void *kpage;
+
+  ASSERT (flags & PAL_USER);
+
+  kpage = palloc_get_page (flags);
+  if (kpage != NULL)
+    {
+      f = kmem_cache_alloc (frame_cache);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+      f->pinned = false;
+      f->io = false;
+      cond_init (&f->io_done);
+
+      /* Insert behind the clock hand, so that the new frame is
+         the last one the clock will look at. */
+      list_insert (hand, &f->elem);
+      frame_cnt++;
+    }
+  else if (evict)
+    {
+      /* Take over the victim's frame, leaving it where it is in
+         the table. */
+      f = evict_frame ();
+      if (f != NULL && (flags & PAL_ZERO))
+        memset (f->kpage, 0, PGSIZE);
+    }
+  else
+    f = NULL;
+  if (f != NULL)
+    f->share = NULL;
+  return f;
+}
+
+/* Removes frame F from the frame table and frees it.  F must no
+   longer be mapped anywhere.
+
+   Must be called with FRAME_LOCK held. */
+static void
+release_frame (struct frame *f)
+{
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  frame_cnt--;
+  palloc_free_page (f->kpage);
+  kmem_cache_free (frame_cache, f);
+}
+
+/* Chooses a frame with the clock (second chance) algorithm,
+   evicts the page it holds, and returns it, still in the frame
+   table.  Frames whose pages were accessed since the last visit
+   of the hand get their accessed bits cleared and are passed
+   over once.  Returns a null pointer if two full turns of the
+   clock turn up nothing that can be evicted.
+
+   Must be called with FRAME_LOCK held.  The lock is released and
+   reacquired if the victim must be written out. */
+static struct frame *
+evict_frame (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f;
+      void *upage;
+
+      if (hand == list_end (&frames))
+        hand = list_begin (&frames);
+      f = list_entry (hand, struct frame, elem);
+      hand = list_next (hand);
+
+      if (f->pinned)
+        continue;
+      if (f->share != NULL)
+        {
+          if (evict_shared (f))
+            {
+              evict_cnt++;
+              return f;
+            }
+          continue;
+        }
+
+      upage = f->page->upage;
+      if (pagedir_is_accessed (f->pd, upage))
+        {
+          pagedir_set_accessed (f->pd, upage, false);
+          continue;
+        }
+      if (evict_page (f))
+        {
+          evict_cnt++;
+          return f;
+        }
+    }
+  return NULL;
+}
+
+/* Evicts the private page in frame F, writing it out if it was
+   modified.  FRAME_LOCK is released during the write, with F
+   pinned, so that the clock passes it over, and marked IO, so
+   that anyone who needs its page waits in wait_for_io().
+   Returns true if successful, false if the page had to be
+   written but swap is full, in which case it stays in F.
+
+   Must be called with FRAME_LOCK held. */
+static bool
+evict_page (struct frame *f)
+{
+  struct page *p = f->page;
+  bool write, was_pinned;
+
+  if (!page_out (p, f->pd, &write))
+    return false;
+  if (write)
+    {
+      was_pinned = f->pinned;
+      f->pinned = f->io = true;
+      lock_release (&frame_lock);
+      page_write (p);
+      lock_acquire (&frame_lock);
+      f->pinned = was_pinned;
+      f->io = false;
+      cond_broadcast (&f->io_done, &frame_lock);
+    }
+  p->frame = NULL;
+  return true;
+}
+
+/* Waits until private page P is not being written out of its
+   frame.  Must be called with FRAME_LOCK held. */
+static void
+wait_for_io (struct page *p)
+{
+  while (p->share == NULL && p->frame != NULL && p->frame->io)
+    cond_wait (&p->frame->io_done, &frame_lock);
+}
+
+/* Evicts the shared page in frame F from every page directory
+   that maps it, unless any of them accessed it since the last
+   visit of the clock hand, in which case all of the accessed
+   bits are cleared instead.  Returns true if F was evicted,
+   false otherwise.  A shared page is never modified, so there is
+   nothing to write.
+
+   Must be called with FRAME_LOCK held. */
+static bool
+evict_shared (struct frame *f)
+{
+  struct share *s = f->share;
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&s->mappers); e != list_end (&s->mappers);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, share_elem);
+      if (pagedir_is_accessed (p->pd, p->upage))
+        {
+          pagedir_set_accessed (p->pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  if (accessed)
+    return false;
+
+  while (!list_empty (&s->mappers))
+    {
+      struct page *p = list_entry (list_pop_front (&s->mappers),
+                                   struct page, share_elem);
+      pagedir_clear_page (p->pd, p->upage);
+      p->frame = NULL;
+      map_cnt--;
+    }
+  s->frame = NULL;
+  shared_cnt--;
+  return true;
+}
+
+/* Unmaps shared page P, if it is mapped, and drops its
+   reference to its share.  The last reference frees the share
+   and its frame.
+
+   Must be called with FRAME_LOCK held. */
+static void
+unshare (struct page *p)
+{
+  struct share *s = p->share;
+
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (p->pd, p->upage);
+      list_remove (&p->share_elem);
+      p->frame = NULL;
+      map_cnt--;
+    }
+  p->share = NULL;
+
+  if (--s->ref_cnt == 0)
+    {
+      if (s->frame != NULL)
+        {
+          ASSERT (list_empty (&s->mappers));
+          release_frame (s->frame);
+          shared_cnt--;
+        }
+      hash_delete (&shares, &s->elem);
+      kmem_cache_free (share_cache, s);
+    }
+}
+
+/* Returns a hash value for share S. */
+static unsigned
+share_hash (const struct hash_elem *s_, void *aux UNUSED)
+{
+  const struct share *s = hash_entry (s_, struct share, elem);
+  return hash_bytes (&s->key, sizeof s->key);
+}
+
+/* Returns true if share A precedes share B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct share *a = hash_entry (a_, struct share, elem);
+  const struct share *b = hash_entry (b_, struct share, elem);
+  return memcmp (&a->key, &b->key, sizeof a->key) < 0;
+}
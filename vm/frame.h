@@ -0,0 +1,49 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+
+struct page;
+
+/* Frame table.
+
+   Every frame of physical memory that holds a user page is
+   recorded in a global table, along with the page directory and
+   supplemental page table entry of the page it holds.  When the
+   user pool runs dry, frame_alloc() takes a frame away from some
+   page, chosen with the clock algorithm, and writes that page
+   out with page_out() and page_write().  The frame table lock is
+   not held during the write, so that page faults elsewhere need
+   not wait for it; the frame stays pinned instead, and a fault
+   on the page being written waits on the frame's IO_DONE.  A
+   shared page is read in the same way.
+
+   Read-only pages of executables are kept in a share cache
+   instead, one frame per page no matter how many processes map
+   it; see frame_alloc_shared(). */
+
+/* A frame holding a user page. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    uint32_t *pd;               /* Owner's page directory, if private. */
+    struct page *page;          /* Page held, if private. */
+    struct share *share;        /* Shared page held, if shared. */
+    bool pinned;                /* True: may not be evicted. */
+    bool io;                    /* Being read or written, unlocked? */
+    struct condition io_done;   /* Signaled when IO becomes false. */
+    struct list_elem elem;      /* Element in frame table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, enum palloc_flags, bool evict);
+bool frame_alloc_shared (struct page *, bool evict);
+void frame_unpin (struct frame *);
+void frame_free (struct page *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
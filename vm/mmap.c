@@ -0,0 +1,138 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    mapid_t id;                 /* Map region identifier. */
+    struct file *file;          /* File, opened just for this. */
+    uint8_t *addr;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+    struct list_elem elem;      /* Element in thread's `mappings'. */
+  };
+
+static struct mapping *find_mapping (mapid_t);
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process's address space starting
+   at ADDR and returns the new mapping's identifier.  The mapping
+   has its own reference to FILE, so it stays valid after FILE is
+   closed.  The final page is padded with zeros, which are not
+   written back.
+
+   Returns MAP_FAILED if FILE is empty, if ADDR is not a nonzero,
+   page-aligned user address, if any page in the range is already
+   in use or lies outside user space, or if memory allocation
+   fails. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  length = file_length (m->file);
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  /* Record each page, backing out if any of them fails. */
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = m->addr + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      uint32_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!is_user_vaddr (upage)
+          || !page_add_mmap (upage, m->file, ofs, read_bytes))
+        {
+          while (i-- > 0)
+            page_remove (m->addr + i * PGSIZE);
+          break;
+        }
+    }
+  if (m->page_cnt == 0 || i < m->page_cnt)
+    {
+      file_close (m->file);
+      free (m);
+      return MAP_FAILED;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps the current process's mapping with identifier ID,
+   writing back each page that was modified.  Does nothing if
+   there is no such mapping. */
+void
+mmap_unmap (mapid_t id)
+{
+  struct mapping *m = find_mapping (id);
+  if (m != NULL)
+    unmap (m);
+}
+
+/* Unmaps all of the current process's mappings, as by
+   mmap_unmap(). */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
+
+/* Returns the current process's mapping with identifier ID, or a
+   null pointer if there is none. */
+static struct mapping *
+find_mapping (mapid_t id)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes mapping M and its pages, writing back those that were
+   modified, and frees it. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->addr + i * PGSIZE);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
@@ -0,0 +1,22 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+struct file;
+
+/* Memory-mapped files.
+
+   A mapping makes the contents of a file appear in a range of a
+   process's address space.  Its pages are recorded in the
+   supplemental page table and read in on demand, like those of
+   an executable, and those that were modified are written back
+   to the file when they are evicted or unmapped. */
+
+/* Map region identifier, as in lib/user/syscall.h. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+mapid_t mmap_map (struct file *, void *addr);
+void mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
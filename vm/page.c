@@ -0,0 +1,406 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Cache of struct page. */
+static struct kmem_cache *page_cache;
+
+/* Statistics. */
+static long long add_cnt;       /* Pages recorded. */
+static long long read_cnt;      /* Pages read in from a file. */
+static long long zero_cnt;      /* Pages brought in as all zeros. */
+static long long write_cnt;     /* Pages written back to a file. */
+static long long around_cnt;    /* Pages mapped by fault-around. */
+
+/* Most pages to map on a single page fault, counting the one
+   faulted on.  Set by the -faultaround kernel command-line
+   option. */
+size_t page_fault_around = 16;
+
+static struct page *page_add (void *upage, bool writable);
+static bool load_page (struct page *, bool speculative);
+static void fault_around (struct page *);
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destructor;
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void)
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page), 0, NULL);
+}
+
+/* Prints paging statistics.  The difference between the pages
+   recorded and the pages brought in is memory and disk reads
+   that loading on demand saved. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages recorded, %lld read in, %lld zero-filled, "
+          "%lld written back\n", add_cnt, read_cnt, zero_cnt, write_cnt);
+  printf ("Paging: %lld pages mapped by fault-around\n", around_cnt);
+}
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns true if successful, false on memory allocation
+   failure. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees all the entries in supplemental page table PAGES, which
+   must belong to the current thread, along with their frames
+   and swap slots and PAGES's own storage.  Must be called while
+   the thread's page directory still exists.  PAGES may also be
+   a table that was never initialized, as long as it is all
+   zeros. */
+void
+page_table_destroy (struct hash *pages)
+{
+  hash_destroy (pages, page_destructor);
+}
+
+/* Records in the current thread's supplemental page table that
+   user page UPAGE is to be loaded on demand by reading
+   READ_BYTES bytes from FILE starting at offset OFS and zeroing
+   the final ZERO_BYTES bytes.  The page will be writable by the
+   user process if WRITABLE is true, read-only otherwise.  FILE
+   must stay open for as long as the page may be loaded.
+
+   Returns true if successful, false if UPAGE is already
+   recorded or if memory allocation fails. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes, uint32_t zero_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes + zero_bytes == PGSIZE);
+
+  p = page_add (upage, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->zero_bytes = zero_bytes;
+  return true;
+}
+
+/* Records in the current thread's supplemental page table that
+   user page UPAGE is to be brought in as a page of zeros.
+   Returns true if successful, false if UPAGE is already recorded
+   or if memory allocation fails. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, writable) != NULL;
+}
+
+/* Records in the current thread's supplemental page table that
+   user page UPAGE maps READ_BYTES bytes of FILE starting at
+   offset OFS, followed by zeros.  The page is writable, and the
+   bytes from FILE are written back to it if they are modified.
+   FILE must stay open for as long as the page is recorded.
+   Returns true if successful, false if UPAGE is already recorded
+   or if memory allocation fails. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_add (upage, true);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->zero_bytes = PGSIZE - read_bytes;
+  p->mmap = true;
+  return true;
+}
+
+/* Removes user page UPAGE from the current thread's
+   supplemental page table, if it is there, writing it back
+   first if it is a modified page of a memory-mapped file. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = upage;
+  e = hash_delete (&t->pages, &p.elem);
+  if (e != NULL)
+    page_destructor (e, NULL);
+}
+
+/* Returns the entry in the current thread's supplemental page
+   table for the page containing user address UADDR, or a null
+   pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&t->pages, &p.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Brings the page containing user address UADDR into memory and
+   maps it in the current thread's page directory.  Returns true
+   if successful, false if UADDR is not in a recorded page, if no
+   frame can be had, or if the disk read fails.
+
+   Also maps some of the pages that follow, if the process seems
+   to be working its way through memory in order; see
+   fault_around(). */
+bool
+page_in (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  p = page_lookup (uaddr);
+  if (p == NULL || pagedir_get_page (t->pagedir, p->upage) != NULL
+      || !load_page (p, false))
+    return false;
+
+  fault_around (p);
+  return true;
+}
+
+/* Brings page P of the current process into memory and maps it.
+   If SPECULATIVE is true, P is not needed yet, so it is only
+   brought in if that is cheap: if it can be read from a file or
+   is already in memory, into a frame that is free now.  Returns
+   true if successful, false otherwise. */
+static bool
+load_page (struct page *p, bool speculative)
+{
+  struct thread *t = thread_current ();
+  struct frame *f;
+  bool zero;
+
+  /* Read-only file pages are the same for every process. */
+  if (!p->writable && p->read_bytes > 0)
+    return frame_alloc_shared (p, !speculative);
+
+  /* Get a frame.  Once we have it, P cannot be under eviction
+     any more, so its swap slot is stable.  A page with nothing
+     to read comes from the zeroed-page stash when possible. */
+  zero = p->read_bytes == 0 && p->swap_slot == SWAP_ERROR;
+  if (speculative && (zero || p->swap_slot != SWAP_ERROR))
+    return false;
+  f = frame_alloc (p, PAL_USER | (zero ? PAL_ZERO : 0), !speculative);
+  if (f == NULL)
+    return false;
+
+  /* Fill it. */
+  if (p->swap_slot != SWAP_ERROR)
+    swap_read (p->swap_slot, f->kpage);
+  else if (!zero)
+    {
+      if (file_read_at (p->file, f->kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_free (p);
+          return false;
+        }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0, p->zero_bytes);
+      read_cnt++;
+    }
+  else
+    zero_cnt++;
+
+  /* Map it. */
+  if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, p->writable))
+    {
+      frame_free (p);
+      return false;
+    }
+  frame_unpin (f);
+  return true;
+}
+
+/* Maps file pages that follow page P, which the current process
+   just faulted on, up to the end of its fault-around window.
+   The window doubles, up to page_fault_around - 1 pages, each
+   time a fault lands just past the pages that the previous
+   fault mapped, as it does in a sequential scan, and halves
+   each time a fault lands anywhere else, so that random access
+   does not waste memory and reads on pages it will never use. */
+static void
+fault_around (struct page *p)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = p->upage;
+  uint8_t *last = t->last_fault;
+  size_t max = page_fault_around > 0 ? page_fault_around - 1 : 0;
+  size_t i;
+
+  if (last != NULL && upage > last
+      && upage <= last + (t->fault_window + 1) * PGSIZE)
+    t->fault_window = t->fault_window == 0 ? 1 : t->fault_window * 2;
+  else
+    t->fault_window /= 2;
+  if (t->fault_window > max)
+    t->fault_window = max;
+  t->last_fault = upage;
+
+  /* Stop at the end of the segment or mapping, or at the first
+     page that would not be cheap to bring in. */
+  for (i = 1; i <= t->fault_window; i++)
+    {
+      uint8_t *next = upage + i * PGSIZE;
+      struct page *q;
+
+      if (!is_user_vaddr (next))
+        break;
+      q = page_lookup (next);
+      if (q == NULL)
+        break;
+      if (pagedir_get_page (t->pagedir, next) != NULL)
+        continue;
+      if (!load_page (q, true))
+        break;
+      around_cnt++;
+    }
+}
+
+/* Starts evicting page P, which is mapped in page directory PD,
+   from its frame.  P is unmapped first, so that its owner faults
+   if it touches P from then on.  If P was modified while it was
+   in memory, it must be written back, to its file if it belongs
+   to a memory-mapped file or to swap otherwise, so *WRITE is set
+   to true, a swap slot is assigned if needed, and the caller
+   must call page_write() before P's frame is reused; if not, its
+   contents can still be found wherever they came from.  Returns
+   true if successful, false if P had to be written but swap is
+   full, in which case P stays in its frame.
+
+   Must be called with the frame table lock held.  The caller
+   clears P's FRAME member once P is out. */
+bool
+page_out (struct page *p, uint32_t *pd, bool *write)
+{
+  ASSERT (p->frame != NULL);
+
+  pagedir_clear_page (pd, p->upage);
+  *write = pagedir_is_dirty (pd, p->upage);
+  if (*write && p->mmap)
+    write_cnt++;
+  else if (*write)
+    {
+      if (p->swap_slot == SWAP_ERROR)
+        p->swap_slot = swap_alloc ();
+      if (p->swap_slot == SWAP_ERROR)
+        {
+          /* Put it back the way it was. */
+          pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, true);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Writes page P, which page_out() found modified, from its frame
+   to its file or swap slot.  May be called without the frame
+   table lock, as long as P's frame stays pinned: P is unmapped,
+   so nothing else touches the frame's contents meanwhile. */
+void
+page_write (struct page *p)
+{
+  ASSERT (p->frame != NULL);
+
+  if (p->mmap)
+    file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+  else
+    swap_write (p->swap_slot, p->frame->kpage);
+}
+
+/* Adds a page at UPAGE with no contents to the current thread's
+   supplemental page table and returns it.  Returns a null
+   pointer if UPAGE is already recorded or if memory allocation
+   fails. */
+static struct page *
+page_add (void *upage, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  p->zero_bytes = PGSIZE;
+  p->mmap = false;
+  p->pd = t->pagedir;
+  p->frame = NULL;
+  p->swap_slot = SWAP_ERROR;
+  p->share = NULL;
+
+  if (hash_insert (&t->pages, &p->elem) != NULL)
+    {
+      kmem_cache_free (page_cache, p);
+      return NULL;
+    }
+  add_cnt++;
+  return p;
+}
+
+/* Returns a hash value for page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, elem);
+  const struct page *b = hash_entry (b_, struct page, elem);
+  return a->upage < b->upage;
+}
+
+/* Frees page P, along with its frame and swap slot, or its
+   reference to a shared frame. */
+static void
+page_destructor (struct hash_elem *p_, void *aux UNUSED)
+{
+  struct page *p = hash_entry (p_, struct page, elem);
+  frame_free (p);
+  if (p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  kmem_cache_free (page_cache, p);
+}
@@ -0,0 +1,82 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+/* Supplemental page table.
+
+   Each process keeps a hash table, keyed by user virtual page,
+   that describes the pages of its address space that are not
+   necessarily present in its page directory: where their
+   contents come from and whether they may be written.  A page
+   that is recorded here but not mapped, because it has not been
+   touched yet or because it was evicted, is brought in by
+   page_in() the next time the process touches it.
+
+   A page's contents are found in the first of these places that
+   applies: its frame, if it has one; its swap slot, if it has
+   one; READ_BYTES bytes of FILE followed by zeros, if READ_BYTES
+   is nonzero; or else all zeros.  A swap slot, once assigned,
+   stays with the page until it is destroyed, so that a page
+   that was not modified after being read back from swap can be
+   evicted again without being written.
+
+   Read-only pages read from a file are never modified, so they
+   are brought in through the frame table's share cache and
+   mapped to one frame in every process that uses them.
+
+   Pages of memory-mapped files never get a swap slot.  When one
+   that was modified leaves memory, its READ_BYTES bytes are
+   written back to FILE instead. */
+
+/* A page of a process's virtual address space. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    bool writable;              /* Read/write or read-only? */
+    struct hash_elem elem;      /* Element in thread's `pages' table. */
+
+    /* Initial contents: READ_BYTES bytes read from FILE at OFS,
+       followed by ZERO_BYTES zeros. */
+    struct file *file;          /* File to read. */
+    off_t ofs;                  /* Offset in FILE. */
+    uint32_t read_bytes;        /* Bytes to read from FILE. */
+    uint32_t zero_bytes;        /* Bytes to zero after those read. */
+    bool mmap;                  /* Write back to FILE, not to swap? */
+
+    uint32_t *pd;               /* Owner's page directory. */
+
+    /* Protected by the frame table lock. */
+    struct frame *frame;        /* Frame holding page, if any. */
+    size_t swap_slot;           /* Swap slot, or SWAP_ERROR if none. */
+    struct share *share;        /* Shared frame's share, if any. */
+    struct list_elem share_elem; /* Element in share's mappers. */
+  };
+
+/* Most pages to map on a single page fault. */
+extern size_t page_fault_around;
+
+void page_init (void);
+void page_print_stats (void);
+
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+
+bool page_add_file (void *upage, struct file *, off_t,
+                    uint32_t read_bytes, uint32_t zero_bytes,
+                    bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t,
+                    uint32_t read_bytes);
+void page_remove (void *upage);
+struct page *page_lookup (const void *uaddr);
+bool page_in (const void *uaddr);
+bool page_out (struct page *, uint32_t *pd, bool *write);
+void page_write (struct page *);
+
+#endif /* vm/page.h */
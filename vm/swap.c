@@ -0,0 +1,95 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in a swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;   /* Swap device, or a null pointer. */
+static struct bitmap *used_slots;   /* Slots in use, one bit per slot. */
+static struct lock swap_lock;       /* Protects USED_SLOTS. */
+
+/* Statistics. */
+static long long read_cnt;          /* Pages read from swap. */
+static long long write_cnt;         /* Pages written to swap. */
+
+/* Initializes swap.  If there is no swap device, every call to
+   swap_alloc() fails. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / SECTORS_PER_SLOT;
+  used_slots = bitmap_create (slot_cnt);
+  if (used_slots == NULL)
+    PANIC ("bitmap creation failed--swap device is too large");
+}
+
+/* Allocates a swap slot and returns its number, or SWAP_ERROR if
+   swap is full. */
+size_t
+swap_alloc (void)
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+  lock_release (&swap_lock);
+
+  return slot != BITMAP_ERROR ? slot : SWAP_ERROR;
+}
+
+/* Frees swap slot SLOT. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  bitmap_reset (used_slots, slot);
+  lock_release (&swap_lock);
+}
+
+/* Reads the page in swap slot SLOT into KPAGE. */
+void
+swap_read (size_t slot, void *kpage)
+{
+  uint8_t *buf = kpage;
+  size_t i;
+
+  ASSERT (bitmap_test (used_slots, slot));
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_device, slot * SECTORS_PER_SLOT + i,
+                buf + i * BLOCK_SECTOR_SIZE);
+  read_cnt++;
+}
+
+/* Writes the page at KPAGE to swap slot SLOT. */
+void
+swap_write (size_t slot, const void *kpage)
+{
+  const uint8_t *buf = kpage;
+  size_t i;
+
+  ASSERT (bitmap_test (used_slots, slot));
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_device, slot * SECTORS_PER_SLOT + i,
+                 buf + i * BLOCK_SECTOR_SIZE);
+  write_cnt++;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %zu slots, %lld pages read, %lld pages written\n",
+          used_slots != NULL ? bitmap_size (used_slots) : 0,
+          read_cnt, write_cnt);
+}
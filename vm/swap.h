@@ -0,0 +1,24 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+
+/* Swap slots.
+
+   The swap block device is divided into page-sized slots,
+   tracked by a bitmap.  A page evicted from memory with
+   contents that cannot be recovered from anywhere else is
+   written to a slot, from which it is read back when next
+   needed. */
+
+/* Returned by swap_alloc() when no slot is free. */
+#define SWAP_ERROR ((size_t) -1)
+
+void swap_init (void);
+size_t swap_alloc (void);
+void swap_free (size_t slot);
+void swap_read (size_t slot, void *kpage);
+void swap_write (size_t slot, const void *kpage);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */